@@ -0,0 +1,61 @@
+/*
+    Tone generator - command line interface
+
+    BSD 2-Clause License
+
+    Copyright (c) 2019, Daniel Lorch
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <climits>
+#include "tonegen.h"
+
+int main() {
+    const int sampleRateHz    = 22050;    // number of samples per second
+    const int numChannels     = 1;        // Mono
+    const int bitsPerSample   = CHAR_BIT; // 8 bits
+    const double volume       = 0.75;     // 0.0 .. 1.0
+
+    Sampler sampler = Sampler(sampleRateHz, bitsPerSample, numChannels);
+    Songs::sampleMary(&sampler, Songs::MARY_NOTE_DURATION, volume);
+
+    std::ofstream maryFile("output/mary.wav", std::ios::out | std::ios::binary);
+    WAVWriter::writeSamplesToBinaryStream(&sampler, &maryFile);
+    maryFile.close();
+    std::cout << "Wrote output/mary.wav" << std::endl;
+
+    // the sampler only ever holds the bell being rendered, the timeline collects the whole program
+    Sampler bellSampler = Sampler(sampleRateHz, bitsPerSample, numChannels);
+    SampleTimeline bellTimeline(sampleRateHz, bitsPerSample, numChannels);
+    Songs::sampleBells(&bellSampler, &bellTimeline, volume);
+
+    std::ofstream bellFile("output/bells.wav", std::ios::out | std::ios::binary);
+    WAVWriter::writeTimelineToBinaryStream(&bellTimeline, &bellFile);
+    bellFile.close();
+    std::cout << "Wrote output/bells.wav" << std::endl;
+
+    return 0;
+}
@@ -33,9 +33,142 @@
 #include <vector>
 #include <cmath>
 #include <climits>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "tonegen.h"
 #include "portable_endian.h"
 
+void ToneGenerator::generateBlock(int toneFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    for(int i=0; i < numSamples; i++)
+    {
+        double timeIndexSeconds = (double)(startIndex + i) / sampleRateHz;
+        result[i] = this->generate(toneFrequencyHz, timeIndexSeconds, durationSeconds);
+    }
+}
+
+void ToneGenerator::generateWarpedBlock(int toneFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    for(int i=0; i < numSamples; i++)
+    {
+        double position = startPosition + i * ratio + 0.5 * i * (i - 1) * ratioStep;
+        result[i] = this->generate(toneFrequencyHz, position / sampleRateHz, durationSeconds);
+    }
+}
+
+void ToneGenerator::setIndexScale(double indexScale)
+{
+}
+
+struct Partial
+{
+    int harmonic;     // multiple of the fundamental frequency
+    double amplitude;
+    bool cosine;      // cos() instead of sin()
+};
+
+// Raises the unit phasor (cosine, sine) to the given power by repeated rotation, which is cheaper than
+// sin()/cos() for the small harmonic numbers of the additive generators
+static void raisePhasor(double cosine, double sine, int power, double* resultCos, double* resultSin)
+{
+    double c = 1.0, s = 0.0;
+
+    for(int k=0; k < power; k++)
+    {
+        double next = c * cosine - s * sine;
+        s           = s * cosine + c * sine;
+        c           = next;
+    }
+
+    *resultCos = c;
+    *resultSin = s;
+}
+
+// Sums sinusoidal partials incrementally: each partial is a unit phasor that is rotated by a fixed angle
+// per sample, replacing the sin()/cos() calls per sample and partial. The start phase is computed exactly
+// for every block, so rounding errors of the rotation cannot accumulate over long notes; the phasors of
+// the harmonics are powers of the fundamental's. Warped blocks (see ToneGenerator::generateWarpedBlock())
+// advance by ratio samples per sample, and the rotation angle itself is rotated by the constant change of
+// ratio per sample.
+static void generatePartials(const Partial* partials, int numPartials, int fundamentalFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double* result, int numSamples)
+{
+    for(int i=0; i < numSamples; i++)
+        result[i] = 0.0;
+
+    const double radiansPerSample = 2 * M_PI * fundamentalFrequencyHz / sampleRateHz;
+    const double startRadians = fmod(radiansPerSample * startPosition, 2 * M_PI);
+    const double fundamentalPhaseCos = cos(startRadians),                  fundamentalPhaseSin = sin(startRadians);
+    const double fundamentalStepCos  = cos(radiansPerSample * ratio),      fundamentalStepSin  = sin(radiansPerSample * ratio);
+    const double fundamentalChangeCos = cos(radiansPerSample * ratioStep), fundamentalChangeSin = sin(radiansPerSample * ratioStep);
+
+    for(int p=0; p < numPartials; p++)
+    {
+        double phaseCos, phaseSin, stepCos, stepSin;
+        raisePhasor(fundamentalPhaseCos, fundamentalPhaseSin, partials[p].harmonic, &phaseCos, &phaseSin);
+        raisePhasor(fundamentalStepCos, fundamentalStepSin, partials[p].harmonic, &stepCos, &stepSin);
+        double amplitude = partials[p].amplitude;
+
+        if(ratioStep == 0)
+        {
+            for(int i=0; i < numSamples; i++)
+            {
+                result[i] += amplitude * (partials[p].cosine ? phaseCos : phaseSin);
+
+                double nextCos = phaseCos * stepCos - phaseSin * stepSin;
+                phaseSin       = phaseSin * stepCos + phaseCos * stepSin;
+                phaseCos       = nextCos;
+            }
+            continue;
+        }
+
+        double changeCos, changeSin;
+        raisePhasor(fundamentalChangeCos, fundamentalChangeSin, partials[p].harmonic, &changeCos, &changeSin);
+
+        for(int i=0; i < numSamples; i++)
+        {
+            result[i] += amplitude * (partials[p].cosine ? phaseCos : phaseSin);
+
+            double nextCos = phaseCos * stepCos - phaseSin * stepSin;
+            phaseSin       = phaseSin * stepCos + phaseCos * stepSin;
+            phaseCos       = nextCos;
+
+            double nextStepCos = stepCos * changeCos - stepSin * changeSin;
+            stepSin            = stepSin * changeCos + stepCos * changeSin;
+            stepCos            = nextStepCos;
+        }
+    }
+}
+
+static const Partial PURE_TONE_PARTIALS[] = { { 1, 1.0, false } };
+
+static const Partial SQUARE_WAVE_PARTIALS[] =
+{
+    { 1, 1.0,       false },
+    { 3, 1.0 / 3.0, false },
+    { 5, 1.0 / 5.0, false },
+    { 7, 1.0 / 7.0, false },
+    { 9, 1.0 / 9.0, false }
+};
+
+// same partials as ViolinGenerator::generate(), which plays harmonics 6 and 7 at the frequency of harmonic 4
+static const Partial VIOLIN_PARTIALS[] =
+{
+    {  1, 0.49 * 0.995, false },
+    {  2, 0.49 * 0.940, true  },
+    {  3, 0.49 * 0.425, false },
+    {  4, 0.49 * 0.480, true  },
+    {  4, 0.49 * 0.365, true  },
+    {  4, 0.49 * 0.040, false },
+    {  8, 0.49 * 0.085, true  },
+    { 10, 0.49 * 0.090, true  }
+};
+
 double PureToneGenerator::generate(int toneFrequencyHz, double timeIndexSeconds, double durationSeconds)
 {
     double tonePeriodSeconds = 1.0 / toneFrequencyHz;
@@ -45,6 +178,16 @@ double PureToneGenerator::generate(int toneFrequencyHz, double timeIndexSeconds,
     return result;
 }
 
+void PureToneGenerator::generateBlock(int toneFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    generatePartials(PURE_TONE_PARTIALS, 1, toneFrequencyHz, startIndex, 1, 0, sampleRateHz, result, numSamples);
+}
+
+void PureToneGenerator::generateWarpedBlock(int toneFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    generatePartials(PURE_TONE_PARTIALS, 1, toneFrequencyHz, startPosition, ratio, ratioStep, sampleRateHz, result, numSamples);
+}
+
 // Square Wave is generated by adding odd-numbered harmonics with decreasing amplitude https://youtu.be/YsZKvLnf7wU?t=363
 double SquareWaveGenerator::generate(int fundamentalFrequencyHz, double timeIndexSeconds, double durationSeconds)
 {
@@ -78,6 +221,16 @@ double SquareWaveGenerator::generate(int fundamentalFrequencyHz, double timeInde
     return result;
 }
 
+void SquareWaveGenerator::generateBlock(int fundamentalFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    generatePartials(SQUARE_WAVE_PARTIALS, sizeof(SQUARE_WAVE_PARTIALS)/sizeof(SQUARE_WAVE_PARTIALS[0]), fundamentalFrequencyHz, startIndex, 1, 0, sampleRateHz, result, numSamples);
+}
+
+void SquareWaveGenerator::generateWarpedBlock(int fundamentalFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    generatePartials(SQUARE_WAVE_PARTIALS, sizeof(SQUARE_WAVE_PARTIALS)/sizeof(SQUARE_WAVE_PARTIALS[0]), fundamentalFrequencyHz, startPosition, ratio, ratioStep, sampleRateHz, result, numSamples);
+}
+
 // Violin sound https://meettechniek.info/additional/additive-synthesis.html
 double ViolinGenerator::generate(int fundamentalFrequencyHz, double timeIndexSeconds, double durationSeconds)
 {
@@ -128,6 +281,16 @@ double ViolinGenerator::generate(int fundamentalFrequencyHz, double timeIndexSec
     return result;
 }
 
+void ViolinGenerator::generateBlock(int fundamentalFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    generatePartials(VIOLIN_PARTIALS, sizeof(VIOLIN_PARTIALS)/sizeof(VIOLIN_PARTIALS[0]), fundamentalFrequencyHz, startIndex, 1, 0, sampleRateHz, result, numSamples);
+}
+
+void ViolinGenerator::generateWarpedBlock(int fundamentalFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    generatePartials(VIOLIN_PARTIALS, sizeof(VIOLIN_PARTIALS)/sizeof(VIOLIN_PARTIALS[0]), fundamentalFrequencyHz, startPosition, ratio, ratioStep, sampleRateHz, result, numSamples);
+}
+
 double ChirpGenerator::generate(int initialFrequencyHz, double timeIndexSeconds, double durationSeconds)
 {
     int finalFrequencyHz = initialFrequencyHz * 10;
@@ -142,19 +305,330 @@ double ChirpGenerator::generate(int initialFrequencyHz, double timeIndexSeconds,
     return result;
 }
 
-BellGenerator::BellGenerator(int fm_Hz, int I0, double tau): fm_Hz(fm_Hz), I0(I0), tau(tau), theta_m(-M_PI/2), theta_c(-M_PI/2)
+BellGenerator::BellGenerator(int fm_Hz, int I0, double tau): fm_Hz(fm_Hz), I0(I0), tau(tau), theta_m(-M_PI/2), theta_c(-M_PI/2), indexScale(1.0)
+{
+}
+
+void BellGenerator::setIndexScale(double indexScale)
 {
+    this->indexScale = indexScale;
 }
 
 double BellGenerator::generate(int fc_Hz, double timeIndexSeconds, double durationSeconds)
 {
     double At = exp(-timeIndexSeconds / this->tau);
-    double It = this->I0 * exp(-timeIndexSeconds / this->tau);
+    double It = this->I0 * this->indexScale * exp(-timeIndexSeconds / this->tau);
     double result = At * cos(2 * M_PI * fc_Hz * timeIndexSeconds + It * cos(2 * M_PI * this->fm_Hz * timeIndexSeconds + this->theta_m) + this->theta_c);
 
     return result;
 }
 
+static uint16_t readLittleEndian16(const unsigned char* data)
+{
+    uint16_t value;
+    memcpy(&value, data, sizeof(value));
+    return le16toh(value);
+}
+
+static uint32_t readLittleEndian32(const unsigned char* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return le32toh(value);
+}
+
+SampleBank::SampleBank(const std::string& path): mapping(MAP_FAILED), mappingSize(0), frames(NULL), numFrames(0), sampleRateHz(0), bitsPerSample(0), numChannels(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat status;
+
+    if(fd < 0 || fstat(fd, &status) < 0)
+    {
+        if(fd >= 0)
+            close(fd);
+        throw std::runtime_error("Cannot open sample bank " + path + ": " + strerror(errno));
+    }
+
+    this->mappingSize = status.st_size;
+    if(this->mappingSize > 0)
+        this->mapping = mmap(NULL, this->mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping stays valid
+
+    if(this->mapping == MAP_FAILED)
+        throw std::runtime_error("Cannot map sample bank " + path);
+
+    const unsigned char* data = (const unsigned char*)this->mapping;
+    const unsigned char* dataChunk = NULL;
+    size_t dataChunkSize = 0;
+
+    try
+    {
+        if(this->mappingSize < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+            throw std::runtime_error("Not a WAV file: " + path);
+
+        // walk the chunk headers only, the sample data itself is not touched
+        size_t offset = 12;
+        while(offset + 8 <= this->mappingSize)
+        {
+            size_t chunkSize = readLittleEndian32(data + offset + 4);
+            const unsigned char* chunk = data + offset + 8;
+            size_t available = std::min(chunkSize, this->mappingSize - offset - 8);
+
+            if(memcmp(data + offset, "fmt ", 4) == 0 && available >= 16)
+            {
+                if(readLittleEndian16(chunk) != 1)
+                    throw std::runtime_error("Unsupported WAV encoding, only PCM is supported: " + path);
+
+                this->numChannels   = readLittleEndian16(chunk + 2);
+                this->sampleRateHz  = readLittleEndian32(chunk + 4);
+                this->bitsPerSample = readLittleEndian16(chunk + 14);
+            }
+            else if(memcmp(data + offset, "data", 4) == 0)
+            {
+                dataChunk = chunk;
+                dataChunkSize = available;
+            }
+
+            offset += 8 + chunkSize + (chunkSize & 1); // chunks are padded to an even size
+        }
+
+        if(this->numChannels <= 0 || this->sampleRateHz <= 0 || (this->bitsPerSample != 8 && this->bitsPerSample != 16))
+            throw std::runtime_error("Unsupported WAV format, only 8 and 16 bit PCM is supported: " + path);
+
+        if(dataChunk == NULL)
+            throw std::runtime_error("WAV file without data: " + path);
+    }
+    catch(...)
+    {
+        munmap(this->mapping, this->mappingSize);
+        throw;
+    }
+
+    this->frames = dataChunk;
+    this->numFrames = dataChunkSize / (this->numChannels * this->bitsPerSample / 8);
+}
+
+SampleBank::~SampleBank()
+{
+    munmap(this->mapping, this->mappingSize);
+}
+
+double SampleBank::getFrame(size_t index)
+{
+    double result = 0;
+
+    if(this->bitsPerSample == 8)
+    {
+        const unsigned char* frame = this->frames + index * this->numChannels;
+        for(int channel=0; channel < this->numChannels; channel++)
+            result += (frame[channel] - 128) / 128.0;
+    }
+    else
+    {
+        const unsigned char* frame = this->frames + index * this->numChannels * 2;
+        for(int channel=0; channel < this->numChannels; channel++)
+            result += (int16_t)readLittleEndian16(frame + channel * 2) / 32768.0;
+    }
+
+    return result / this->numChannels;
+}
+
+void SampleBank::prefetch(size_t firstFrame, size_t numFrames)
+{
+    if(firstFrame >= this->numFrames)
+        return;
+
+    size_t frameSize = this->numChannels * this->bitsPerSample / 8;
+    size_t pageSize  = sysconf(_SC_PAGESIZE);
+    size_t start     = (this->frames - (const unsigned char*)this->mapping) + firstFrame * frameSize;
+    size_t end       = start + std::min(numFrames, this->numFrames - firstFrame) * frameSize;
+    size_t pageStart = start / pageSize * pageSize;
+
+    madvise((char*)this->mapping + pageStart, end - pageStart, MADV_WILLNEED);
+}
+
+size_t SampleBank::getNumFrames()
+{
+    return this->numFrames;
+}
+
+int SampleBank::getSampleRateHz()
+{
+    return this->sampleRateHz;
+}
+
+// Blackman windowed sinc kernel, tabulated on first use: row p holds the SINC_TAPS coefficients for a
+// position p/SINC_PHASES past the frame at tap SINC_TAPS/2 - 1, normalized to unity gain
+static const double* getSincTable()
+{
+    static const std::vector<double> table = []
+    {
+        const int taps = SampleGenerator::SINC_TAPS;
+        std::vector<double> result((SampleGenerator::SINC_PHASES + 1) * taps);
+
+        for(int phase=0; phase <= SampleGenerator::SINC_PHASES; phase++)
+        {
+            double fraction = (double)phase / SampleGenerator::SINC_PHASES;
+            double* row = &result[phase * taps];
+            double sum = 0;
+
+            for(int k=0; k < taps; k++)
+            {
+                double x = k - (taps / 2 - 1) - fraction;
+                double sinc = x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+                double window = 0.42 + 0.5 * cos(2 * M_PI * x / taps) + 0.08 * cos(4 * M_PI * x / taps);
+                row[k] = sinc * window;
+                sum += row[k];
+            }
+
+            for(int k=0; k < taps; k++)
+                row[k] /= sum;
+        }
+
+        return result;
+    }();
+
+    return &table[0];
+}
+
+// y points at the frame before the position, fraction is the distance past the frame after it
+static inline double interpolateCubic(const double* y, double fraction)
+{
+    double a = -0.5 * y[0] + 1.5 * y[1] - 1.5 * y[2] + 0.5 * y[3];
+    double b =        y[0] - 2.5 * y[1] + 2.0 * y[2] - 0.5 * y[3];
+    double c = -0.5 * y[0]              + 0.5 * y[2];
+
+    return ((a * fraction + b) * fraction + c) * fraction + y[1];
+}
+
+// x points at the first of SINC_TAPS frames, the position is fraction past x[SINC_TAPS/2 - 1]
+static inline double interpolateSinc(const double* x, double fraction)
+{
+    const double* coefficients = getSincTable() + (int)(fraction * SampleGenerator::SINC_PHASES + 0.5) * SampleGenerator::SINC_TAPS;
+    double result = 0;
+
+    // fixed trip count without dependencies between iterations, so the compiler can vectorize it
+    for(int k=0; k < SampleGenerator::SINC_TAPS; k++)
+        result += coefficients[k] * x[k];
+
+    return result;
+}
+
+SampleGenerator::SampleGenerator(std::shared_ptr<SampleBank> bank, int rootFrequencyHz, InterpolationMode interpolation): bank(bank), rootFrequencyHz(rootFrequencyHz), interpolation(interpolation), loopStartFrame(0), loopEndFrame(0)
+{
+    if(rootFrequencyHz <= 0)
+        throw std::logic_error("Invalid value for rootFrequencyHz: must be positive non-zero value");
+}
+
+void SampleGenerator::setLoop(long loopStartFrame, long loopEndFrame)
+{
+    if(loopStartFrame < 0 || loopEndFrame > (long)this->bank->getNumFrames() || (loopEndFrame != 0 && loopEndFrame <= loopStartFrame))
+        throw std::logic_error("Invalid loop: must be within the sample bank and end after its start");
+
+    this->loopStartFrame = loopStartFrame;
+    this->loopEndFrame = loopEndFrame;
+}
+
+bool SampleGenerator::isLooping()
+{
+    return this->loopEndFrame > this->loopStartFrame;
+}
+
+double SampleGenerator::frameAt(long index)
+{
+    if(this->isLooping() && index >= this->loopEndFrame)
+        index = this->loopStartFrame + (index - this->loopStartFrame) % (this->loopEndFrame - this->loopStartFrame);
+
+    if(index < 0 || index >= (long)this->bank->getNumFrames())
+        return 0.0;
+
+    return this->bank->getFrame(index);
+}
+
+double SampleGenerator::interpolate(double position)
+{
+    if(this->isLooping() && position >= this->loopEndFrame)
+        position = this->loopStartFrame + fmod(position - this->loopStartFrame, this->loopEndFrame - this->loopStartFrame);
+
+    long index = (long)floor(position);
+    double fraction = position - index;
+
+    if(this->interpolation == CUBIC_INTERPOLATION)
+    {
+        double y[4];
+        for(int k=0; k < 4; k++)
+            y[k] = this->frameAt(index - 1 + k);
+
+        return interpolateCubic(y, fraction);
+    }
+
+    double x[SINC_TAPS];
+    for(int k=0; k < SINC_TAPS; k++)
+        x[k] = this->frameAt(index - (SINC_TAPS / 2 - 1) + k);
+
+    return interpolateSinc(x, fraction);
+}
+
+double SampleGenerator::generate(int toneFrequencyHz, double timeIndexSeconds, double durationSeconds)
+{
+    double position = timeIndexSeconds * this->bank->getSampleRateHz() * toneFrequencyHz / this->rootFrequencyHz;
+
+    return this->interpolate(position);
+}
+
+// Decodes the frames a block needs once into a contiguous buffer and interpolates straight from it,
+// instead of fetching and decoding every tap of every sample. Sample k is at frame position
+// startPosition + k * step + k * (k - 1) / 2 * stepChange. Returns false for blocks that cross the loop
+// end or the ends of the bank, which take the per sample path.
+bool SampleGenerator::interpolateBlock(double startPosition, double step, double stepChange, double* result, int numSamples)
+{
+    if(this->isLooping() && startPosition >= this->loopEndFrame)
+        startPosition = this->loopStartFrame + fmod(startPosition - this->loopStartFrame, this->loopEndFrame - this->loopStartFrame);
+
+    const double endPosition = startPosition + (numSamples - 1) * step + 0.5 * (numSamples - 1) * (numSamples - 2) * stepChange;
+    const long firstFrame = (long)floor(startPosition) - SINC_TAPS / 2;
+    const long lastFrame = (long)floor(endPosition) + SINC_TAPS / 2;
+    const long endFrame = this->isLooping() ? this->loopEndFrame : (long)this->bank->getNumFrames();
+
+    if(firstFrame < 0 || lastFrame >= endFrame)
+        return false;
+
+    this->decoded.resize(lastFrame - firstFrame + 1);
+    for(long frame=firstFrame; frame <= lastFrame; frame++)
+        this->decoded[frame - firstFrame] = this->bank->getFrame(frame);
+
+    for(int i=0; i < numSamples; i++)
+    {
+        double position = startPosition + i * step + 0.5 * i * (i - 1) * stepChange;
+        long index = (long)floor(position);
+        double fraction = position - index;
+
+        if(this->interpolation == CUBIC_INTERPOLATION)
+            result[i] = interpolateCubic(&this->decoded[index - 1 - firstFrame], fraction);
+        else
+            result[i] = interpolateSinc(&this->decoded[index - (SINC_TAPS / 2 - 1) - firstFrame], fraction);
+    }
+
+    return true;
+}
+
+void SampleGenerator::generateBlock(int toneFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    const double step = (double)this->bank->getSampleRateHz() * toneFrequencyHz / this->rootFrequencyHz / sampleRateHz;
+    const double startPosition = (double)startIndex / sampleRateHz * this->bank->getSampleRateHz() * toneFrequencyHz / this->rootFrequencyHz;
+
+    if(!this->interpolateBlock(startPosition, step, 0, result, numSamples))
+        ToneGenerator::generateBlock(toneFrequencyHz, startIndex, sampleRateHz, durationSeconds, result, numSamples);
+}
+
+void SampleGenerator::generateWarpedBlock(int toneFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples)
+{
+    const double step = (double)this->bank->getSampleRateHz() * toneFrequencyHz / this->rootFrequencyHz / sampleRateHz;
+
+    if(!this->interpolateBlock(startPosition * step, ratio * step, ratioStep * step, result, numSamples))
+        ToneGenerator::generateWarpedBlock(toneFrequencyHz, startPosition, ratio, ratioStep, sampleRateHz, durationSeconds, result, numSamples);
+}
+
 double NoEnvelope::getAmplitude(double timeIndexSeconds)
 {
     return 1.0;
@@ -224,7 +698,129 @@ double BellEnvelope::getAmplitude(double timeIndexSeconds)
     return result;
 }
 
-Sampler::Sampler(int sampleRateHz, int bitsPerSample, int numChannels): sampleRateHz(sampleRateHz), bitsPerSample(bitsPerSample), numChannels(numChannels)
+LFO::LFO(double rateHz, double depth, LFOShape shape, double center): rateHz(rateHz), depth(depth), shape(shape), center(center)
+{
+}
+
+double LFO::getValue(double timeIndexSeconds)
+{
+    double cycles = timeIndexSeconds * this->rateHz;
+    double phase = cycles - floor(cycles); // 0.0 .. 1.0
+    double result;
+
+    switch(this->shape)
+    {
+        case LFO_SINE:     result = sin(2 * M_PI * phase);                          break;
+        case LFO_TRIANGLE: result = phase < 0.5 ? 4 * phase - 1 : 3 - 4 * phase;   break;
+        case LFO_SQUARE:   result = phase < 0.5 ? 1.0 : -1.0;                       break;
+        case LFO_SAWTOOTH: result = 2 * phase - 1;                                  break;
+        default:           throw std::logic_error("Unknown LFO shape");
+    }
+
+    return this->center + this->depth * result;
+}
+
+void AutomationCurve::addBreakpoint(double timeIndexSeconds, double value)
+{
+    if(!this->breakpointTimes.empty() && timeIndexSeconds < this->breakpointTimes.back())
+        throw std::logic_error("Invalid breakpoint: must not be earlier than the previous breakpoint");
+
+    this->breakpointTimes.push_back(timeIndexSeconds);
+    this->breakpointValues.push_back(value);
+}
+
+double AutomationCurve::getValue(double timeIndexSeconds)
+{
+    if(this->breakpointTimes.empty())
+        throw std::logic_error("Automation curve without breakpoints");
+
+    size_t next = std::upper_bound(this->breakpointTimes.begin(), this->breakpointTimes.end(), timeIndexSeconds) - this->breakpointTimes.begin();
+
+    if(next == 0)
+        return this->breakpointValues.front();
+    if(next == this->breakpointTimes.size())
+        return this->breakpointValues.back();
+
+    double startTime = this->breakpointTimes[next - 1];
+    double position  = (timeIndexSeconds - startTime) / (this->breakpointTimes[next] - startTime);
+
+    return this->breakpointValues[next - 1] + position * (this->breakpointValues[next] - this->breakpointValues[next - 1]);
+}
+
+Modulation::Modulation(int controlPeriodSamples): glideSeconds(0), controlPeriodSamples(controlPeriodSamples)
+{
+    if(controlPeriodSamples <= 0)
+        throw std::logic_error("Invalid value for controlPeriodSamples: must be positive non-zero value");
+}
+
+void Modulation::addPitchModulation(ControlSource* cents)
+{
+    this->pitchSources.push_back(cents);
+}
+
+void Modulation::addAmplitudeModulation(ControlSource* gain)
+{
+    this->amplitudeSources.push_back(gain);
+}
+
+void Modulation::addIndexModulation(ControlSource* indexScale)
+{
+    this->indexSources.push_back(indexScale);
+}
+
+void Modulation::setGlide(double glideSeconds)
+{
+    if(glideSeconds < 0)
+        throw std::logic_error("Invalid value for glideSeconds: must not be negative");
+
+    this->glideSeconds = glideSeconds;
+}
+
+int Modulation::getControlPeriodSamples()
+{
+    return this->controlPeriodSamples;
+}
+
+bool Modulation::hasIndexModulation()
+{
+    return !this->indexSources.empty();
+}
+
+double Modulation::getPitchCents(double timeIndexSeconds, int previousToneFrequencyHz, int toneFrequencyHz)
+{
+    double result = 0;
+
+    for(size_t i=0; i < this->pitchSources.size(); i++)
+        result += this->pitchSources[i]->getValue(timeIndexSeconds);
+
+    // glide starts at the previous note's pitch and reaches the current one linearly in cents
+    if(previousToneFrequencyHz > 0 && timeIndexSeconds < this->glideSeconds)
+        result += 1200 * log2((double)previousToneFrequencyHz / toneFrequencyHz) * (1 - timeIndexSeconds / this->glideSeconds);
+
+    return result;
+}
+
+double Modulation::getAmplitude(double timeIndexSeconds)
+{
+    double result = 1.0;
+
+    for(size_t i=0; i < this->amplitudeSources.size(); i++)
+        result *= this->amplitudeSources[i]->getValue(timeIndexSeconds);
+
+    return result;
+}
+
+double Modulation::getIndexScale(double timeIndexSeconds)
+{
+    double result = 1.0;
+
+    for(size_t i=0; i < this->indexSources.size(); i++)
+        result *= this->indexSources[i]->getValue(timeIndexSeconds);
+
+    return result;
+}
+
+Sampler::Sampler(int sampleRateHz, int bitsPerSample, int numChannels): sampleRateHz(sampleRateHz), bitsPerSample(bitsPerSample), numChannels(numChannels), renderMode(REFERENCE_RENDERING), previousToneFrequencyHz(0)
 {
     if(numChannels != 1)
         throw std::logic_error("Unsupported value for numChannels: only 1 channel (mono) supported");
@@ -240,7 +836,26 @@ void Sampler::sample(ToneGenerator* generator, int toneFrequencyHz, double durat
     else if(volume < 0 || volume > 1)
         throw std::logic_error("Invalid volume: must be within range 0.0 .. 1.0");
 
-    const double sampleValueRange = pow(2, this->bitsPerSample);
+    if(this->renderMode == BLOCK_RENDERING)
+    {
+        const long numSamples = (long)ceil(this->sampleRateHz * durationSeconds);
+        double block[BLOCK_SIZE];
+
+        for(long start=0; start < numSamples; start += BLOCK_SIZE)
+        {
+            int blockSamples = (int)std::min((long)BLOCK_SIZE, numSamples - start);
+            generator->generateBlock(toneFrequencyHz, start, this->sampleRateHz, durationSeconds, block, blockSamples);
+
+            for(int i=0; i < blockSamples; i++)
+            {
+                double timeIndexSeconds = (double)(start + i) / this->sampleRateHz;
+                this->sampleData.push_back(this->quantize(block[i] * envelope->getAmplitude(timeIndexSeconds) * volume));
+            }
+        }
+
+        this->previousToneFrequencyHz = toneFrequencyHz;
+        return;
+    }
 
     for(int i=0; i < this->sampleRateHz * durationSeconds; i++) {
         double timeIndexSeconds = (double)i / this->sampleRateHz;
@@ -252,10 +867,139 @@ void Sampler::sample(ToneGenerator* generator, int toneFrequencyHz, double durat
         // apply volume
         sample = sample * volume;
 
-        // map continous result from tone generator [-1.0, 1.0] to discrete sample value range [0 .. 255]
-        char sampleValue = (sample + 1.0) / 2.0 * sampleValueRange;
-        this->sampleData.push_back(sampleValue);
+        this->sampleData.push_back(this->quantize(sample));
+    }
+
+    this->previousToneFrequencyHz = toneFrequencyHz;
+}
+
+// Control values are evaluated once per control period and interpolated linearly per sample, so the
+// modulation sources add almost no cost per sample. The pitch ratio advances a warped sample index,
+// which keeps the generator's phase continuous while the frequency changes. In BLOCK_RENDERING mode the
+// index scale is set once per control period, and periods without a pitch deviation are rendered through
+// generateBlock(), all others through generateWarpedBlock().
+void Sampler::sample(ToneGenerator* generator, int toneFrequencyHz, double durationSeconds, Envelope* envelope, double volume, Modulation* modulation)
+{
+    if(volume == 11) // loudest
+        volume = 1.0;
+    else if(volume < 0 || volume > 1)
+        throw std::logic_error("Invalid volume: must be within range 0.0 .. 1.0");
+
+    const long numSamples = (long)ceil(this->sampleRateHz * durationSeconds);
+    const int controlPeriod = modulation->getControlPeriodSamples();
+    const bool indexModulation = modulation->hasIndexModulation();
+
+    double warpedSamples = 0; // accumulated deviation of the warped sample index from the sample index
+
+    double nextTimeIndexSeconds = 0;
+    double nextRatio = pow(2, modulation->getPitchCents(nextTimeIndexSeconds, this->previousToneFrequencyHz, toneFrequencyHz) / 1200);
+    double nextGain  = modulation->getAmplitude(nextTimeIndexSeconds);
+    double nextIndex = modulation->getIndexScale(nextTimeIndexSeconds);
+
+    for(long start=0; start < numSamples; start += controlPeriod)
+    {
+        double ratio = nextRatio;
+        double gain  = nextGain;
+        double index = nextIndex;
+
+        nextTimeIndexSeconds = (double)(start + controlPeriod) / this->sampleRateHz;
+        nextRatio = pow(2, modulation->getPitchCents(nextTimeIndexSeconds, this->previousToneFrequencyHz, toneFrequencyHz) / 1200);
+        nextGain  = modulation->getAmplitude(nextTimeIndexSeconds);
+        nextIndex = modulation->getIndexScale(nextTimeIndexSeconds);
+
+        const double ratioStep = (nextRatio - ratio) / controlPeriod;
+        const double gainStep  = (nextGain - gain) / controlPeriod;
+        const double indexStep = (nextIndex - index) / controlPeriod;
+        const long end = std::min(start + controlPeriod, numSamples);
+
+        if(this->renderMode == BLOCK_RENDERING)
+        {
+            if(indexModulation)
+                generator->setIndexScale(index + indexStep * (end - start) / 2);
+
+            const bool unwarped = ratio == 1 && nextRatio == 1 && warpedSamples == floor(warpedSamples);
+            double block[BLOCK_SIZE];
+
+            for(long blockStart=start; blockStart < end; blockStart += BLOCK_SIZE)
+            {
+                int blockSamples = (int)std::min((long)BLOCK_SIZE, end - blockStart);
+
+                if(unwarped)
+                    generator->generateBlock(toneFrequencyHz, blockStart + (long)warpedSamples, this->sampleRateHz, durationSeconds, block, blockSamples);
+                else
+                {
+                    generator->generateWarpedBlock(toneFrequencyHz, blockStart + warpedSamples, ratio, ratioStep, this->sampleRateHz, durationSeconds, block, blockSamples);
+
+                    // advance exactly like the reference path
+                    for(int k=0; k < blockSamples; k++)
+                    {
+                        warpedSamples += ratio - 1;
+                        ratio += ratioStep;
+                    }
+                }
+
+                for(int k=0; k < blockSamples; k++)
+                {
+                    double timeIndexSeconds = (double)(blockStart + k) / this->sampleRateHz;
+                    this->sampleData.push_back(this->quantize(block[k] * envelope->getAmplitude(timeIndexSeconds) * volume * gain));
+                    gain += gainStep;
+                }
+            }
+
+            continue;
+        }
+
+        for(long i=start; i < end; i++)
+        {
+            double timeIndexSeconds = (double)i / this->sampleRateHz;
+            double warpedTimeIndexSeconds = (i + warpedSamples) / this->sampleRateHz;
+
+            if(indexModulation)
+                generator->setIndexScale(index);
+
+            double sample = generator->generate(toneFrequencyHz, warpedTimeIndexSeconds, durationSeconds);
+            sample = sample * envelope->getAmplitude(timeIndexSeconds) * volume * gain;
+            this->sampleData.push_back(this->quantize(sample));
+
+            warpedSamples += ratio - 1;
+            ratio += ratioStep;
+            gain  += gainStep;
+            index += indexStep;
+        }
     }
+
+    if(indexModulation)
+        generator->setIndexScale(1.0);
+
+    this->previousToneFrequencyHz = toneFrequencyHz;
+}
+
+char Sampler::quantize(double sample)
+{
+    const double sampleValueRange = 1 << this->bitsPerSample;
+
+    // map continous result from tone generator [-1.0, 1.0] to discrete sample value range [0 .. 255]
+    double sampleValue = (sample + 1.0) / 2.0 * sampleValueRange;
+
+    // clip instead of wrapping around when modulation drives the sample out of range
+    sampleValue = std::min(std::max(sampleValue, 0.0), sampleValueRange - 1);
+    return (char)sampleValue;
+}
+
+void Sampler::setRenderMode(RenderMode renderMode)
+{
+    this->renderMode = renderMode;
+}
+
+void Sampler::reserve(double durationSeconds)
+{
+    this->sampleData.reserve(this->sampleData.size() + (size_t)ceil(this->sampleRateHz * durationSeconds) * this->numChannels);
+}
+
+void Sampler::clear()
+{
+    this->sampleData.clear();
+    this->previousToneFrequencyHz = 0;
 }
 
 int Sampler::getSampleRateHz()
@@ -278,12 +1022,204 @@ std::vector<char>& Sampler::getSampleData()
     return this->sampleData;
 }
 
+const size_t SampleTimeline::BLOCK_SIZE;
+const size_t SampleTimeline::BLOCKS_PER_SLAB;
+const char SampleTimeline::SILENCE;
+
+// shared source of silent spans, so iterating over silence needs no memory per block
+static const char* getSilentBlock()
+{
+    static const std::vector<char> silentBlock(SampleTimeline::BLOCK_SIZE, SampleTimeline::SILENCE);
+    return &silentBlock[0];
+}
+
+static bool isSilent(const char* samples, size_t numSamples)
+{
+    for(size_t i=0; i < numSamples; i++)
+    {
+        if(samples[i] != SampleTimeline::SILENCE)
+            return false;
+    }
+
+    return true;
+}
+
+SampleTimeline::SampleTimeline(int sampleRateHz, int bitsPerSample, int numChannels): sampleRateHz(sampleRateHz), bitsPerSample(bitsPerSample), numChannels(numChannels), length(0)
+{
+    if(numChannels != 1)
+        throw std::logic_error("Unsupported value for numChannels: only 1 channel (mono) supported");
+
+    if(bitsPerSample != 8)
+        throw std::logic_error("Unsupported value for bitsPerSample: only 8 bits supported");
+}
+
+SampleTimeline::~SampleTimeline()
+{
+    for(size_t i=0; i < this->slabs.size(); i++)
+        delete[] this->slabs[i];
+}
+
+char* SampleTimeline::allocateBlock()
+{
+    if(this->freeBlocks.empty())
+    {
+        char* slab = new char[BLOCK_SIZE * BLOCKS_PER_SLAB];
+        this->slabs.push_back(slab);
+
+        for(size_t i=BLOCKS_PER_SLAB; i > 0; i--)
+            this->freeBlocks.push_back(slab + (i - 1) * BLOCK_SIZE);
+    }
+
+    char* block = this->freeBlocks.back();
+    this->freeBlocks.pop_back();
+    std::fill(block, block + BLOCK_SIZE, SILENCE);
+
+    return block;
+}
+
+void SampleTimeline::releaseBlockIfSilent(size_t blockIndex)
+{
+    char* block = this->blocks[blockIndex];
+
+    if(block != NULL && isSilent(block, BLOCK_SIZE))
+    {
+        this->freeBlocks.push_back(block);
+        this->blocks[blockIndex] = NULL;
+    }
+}
+
+// runs operation(block, samples, numSamples) over each block touched by the given range, storing only
+// blocks that end up holding sound
+template<typename Operation>
+void SampleTimeline::apply(size_t offset, const char* samples, size_t numSamples, Operation operation)
+{
+    this->extend(offset + numSamples);
+
+    while(numSamples > 0)
+    {
+        size_t blockIndex  = offset / BLOCK_SIZE;
+        size_t blockOffset = offset % BLOCK_SIZE;
+        size_t count       = std::min(numSamples, BLOCK_SIZE - blockOffset);
+
+        if(this->blocks[blockIndex] != NULL || !isSilent(samples, count))
+        {
+            if(this->blocks[blockIndex] == NULL)
+                this->blocks[blockIndex] = this->allocateBlock();
+
+            operation(this->blocks[blockIndex] + blockOffset, samples, count);
+            this->releaseBlockIfSilent(blockIndex);
+        }
+
+        offset     += count;
+        samples    += count;
+        numSamples -= count;
+    }
+}
+
+void SampleTimeline::overwrite(size_t offset, const char* samples, size_t numSamples)
+{
+    this->apply(offset, samples, numSamples, [](char* target, const char* source, size_t count)
+    {
+        std::copy(source, source + count, target);
+    });
+}
+
+void SampleTimeline::mixIn(size_t offset, const char* samples, size_t numSamples)
+{
+    this->apply(offset, samples, numSamples, [](char* target, const char* source, size_t count)
+    {
+        for(size_t i=0; i < count; i++)
+        {
+            // unsigned samples are centered at 128, so the sum has to be re-centered
+            int mixed = (unsigned char)target[i] + (unsigned char)source[i] - 128;
+            target[i] = (char)std::max(0, std::min(255, mixed));
+        }
+    });
+}
+
+void SampleTimeline::extend(size_t length)
+{
+    if(length > this->length)
+    {
+        this->length = length;
+        this->blocks.resize((length + BLOCK_SIZE - 1) / BLOCK_SIZE, NULL);
+    }
+}
+
+SampleTimeline::Iterator SampleTimeline::iterate()
+{
+    return Iterator(this);
+}
+
+size_t SampleTimeline::getLength()
+{
+    return this->length;
+}
+
+size_t SampleTimeline::getStoredBlocks()
+{
+    return this->slabs.size() * BLOCKS_PER_SLAB - this->freeBlocks.size();
+}
+
+int SampleTimeline::getSampleRateHz()
+{
+    return this->sampleRateHz;
+}
+
+int SampleTimeline::getBitsPerSample()
+{
+    return this->bitsPerSample;
+}
+
+int SampleTimeline::getNumChannels()
+{
+    return this->numChannels;
+}
+
+SampleTimeline::Iterator::Iterator(SampleTimeline* timeline): timeline(timeline), blockIndex(0)
+{
+}
+
+bool SampleTimeline::Iterator::next(SampleSpan* span)
+{
+    if(this->blockIndex >= this->timeline->blocks.size())
+        return false;
+
+    const char* block = this->timeline->blocks[this->blockIndex];
+    size_t blockStart = this->blockIndex * BLOCK_SIZE;
+
+    span->data   = block != NULL ? block : getSilentBlock();
+    span->length = std::min(BLOCK_SIZE, this->timeline->length - blockStart);
+
+    this->blockIndex++;
+    return true;
+}
+
 // WAVE Format: http://soundfile.sapp.org/doc/WaveFormat/
-void WAVWriter::writeSamplesToBinaryStream(Sampler *sampler, std::ofstream *wavStream)
+void WAVWriter::writeSamplesToBinaryStream(Sampler *sampler, std::ostream *wavStream)
+{
+    writeHeader(sampler->getSampleRateHz(), sampler->getBitsPerSample(), sampler->getNumChannels(), sampler->getSampleData().size(), wavStream);
+    // data() rather than &[0], which is undefined for a sampler without samples
+    // C++ apparently guarantees, that the first element of a vector points to consecutive memory of the data
+    wavStream->write(sampler->getSampleData().data(), sizeof(char)*sampler->getSampleData().size());
+}
+
+void WAVWriter::writeTimelineToBinaryStream(SampleTimeline* timeline, std::ostream* wavStream)
+{
+    writeHeader(timeline->getSampleRateHz(), timeline->getBitsPerSample(), timeline->getNumChannels(), timeline->getLength(), wavStream);
+
+    // the spans point straight into the timeline's blocks, nothing is copied
+    SampleTimeline::Iterator iterator = timeline->iterate();
+    SampleSpan span;
+    while(iterator.next(&span))
+        wavStream->write(span.data, sizeof(char)*span.length);
+}
+
+void WAVWriter::writeHeader(int sampleRateHz, int bitsPerSample, int numChannels, size_t numSamples, std::ostream* wavStream)
 {
     DataSubChunk dataSubChunk;
     dataSubChunk.Subchunk2ID   = htobe32(0x64617461); // "data"
-    dataSubChunk.Subchunk2Size = htole32(sampler->getSampleData().size() * sampler->getNumChannels() * sampler->getBitsPerSample()/8);
+    dataSubChunk.Subchunk2Size = htole32(numSamples * numChannels * bitsPerSample/8);
 
     // WTF MSFT: mixed big- and little endian in the *same* header structs? You've got to be kidding me...
 
@@ -291,11 +1227,11 @@ void WAVWriter::writeSamplesToBinaryStream(Sampler *sampler, std::ofstream *wavS
     fmtSubChunk.Subchunk1ID   = htobe32(0x666d7420); // "fmt "
     fmtSubChunk.Subchunk1Size = htole32(16);         // size of the rest of this subchunk
     fmtSubChunk.AudioFormat   = htole32(1);          // PCM (i.e. linear quantization)
-    fmtSubChunk.NumChannels   = htole32(sampler->getNumChannels());
-    fmtSubChunk.SampleRate    = htole32(sampler->getSampleRateHz());
-    fmtSubChunk.ByteRate      = htole32(sampler->getSampleRateHz() * sampler->getNumChannels() * sampler->getBitsPerSample()/8);
-    fmtSubChunk.BlockAlign    = htole32(sampler->getNumChannels() * sampler->getBitsPerSample()/8);
-    fmtSubChunk.BitsPerSample = htole32(sampler->getBitsPerSample());
+    fmtSubChunk.NumChannels   = htole32(numChannels);
+    fmtSubChunk.SampleRate    = htole32(sampleRateHz);
+    fmtSubChunk.ByteRate      = htole32(sampleRateHz * numChannels * bitsPerSample/8);
+    fmtSubChunk.BlockAlign    = htole32(numChannels * bitsPerSample/8);
+    fmtSubChunk.BitsPerSample = htole32(bitsPerSample);
 
     RIFFHeader riffHeader;
     riffHeader.ChunkID   = htobe32(0x52494646); // "RIFF"
@@ -305,17 +1241,36 @@ void WAVWriter::writeSamplesToBinaryStream(Sampler *sampler, std::ofstream *wavS
     wavStream->write((char *)&riffHeader, sizeof(riffHeader));
     wavStream->write((char *)&fmtSubChunk, sizeof(fmtSubChunk));
     wavStream->write((char *)&dataSubChunk, sizeof(dataSubChunk));
-    // C++ apparently guarantees, that the first element of a vector points to consecutive memory of the data
-    wavStream->write((char *)&sampler->getSampleData()[0], sizeof(char)*sampler->getSampleData().size());
 }
 
-int main() {
-    const int sampleRateHz    = 22050;    // number of samples per second
-    const int numChannels     = 1;        // Mono
-    const int bitsPerSample   = CHAR_BIT; // 8 bits
-    const double volume       = 0.75;     // 0.0 .. 1.0
-    const double noteDuration = 0.25;     // seconds
-
+// Mary had a Little Lamb: http://www.choose-piano-lessons.com/piano-notes.html
+const int Songs::MARY_SONG[Songs::MARY_LENGTH] =
+{
+//  Ma-----ry    had      a     lit----le    lamb
+    E4,    D4,    C4,    D4,    E4,    E4,    E4,
+//  lit----le    lamb,   lit----le    lamb
+    D4,    D4,    D4,    E4,    E4,    E4,
+//  Ma-----ry    had      a     lit----le    lamb
+    E4,    D4,    C4,    D4,    E4,    E4,    E4,
+//  Its  fleece  was    white   as    snow.
+    E4,    D4,    D4,    E4,    D4,    C4
+};
+
+const double Songs::MARY_NOTE_DURATION = 0.25;
+
+const BellPreset Songs::BELLS[Songs::NUM_BELLS] =
+{
+//    fm_Hz  I0   tau   fc_Hz  duration
+    { 220,   10,    2,  110,   6 },
+    { 440,    5,    2,  220,   6 },
+    { 220,   10,   12,  110,   3 },
+    { 220,   10,  0.3,  110,   3 },
+    { 350,    5,    2,  250,   5 },
+    { 350,    3,    1,  250,   5 }
+};
+
+void Songs::sampleMary(Sampler* sampler, double noteDuration, double volume)
+{
     PureToneGenerator pureTone     = PureToneGenerator();
     SquareWaveGenerator squareWave = SquareWaveGenerator();
     ViolinGenerator violin         = ViolinGenerator();
@@ -324,91 +1279,51 @@ int main() {
     NoEnvelope noEnvelope     = NoEnvelope();
     ADSREnvelope adsrEnvelope = ADSREnvelope(noteDuration);
 
-    Sampler sampler = Sampler(sampleRateHz, bitsPerSample, numChannels);
-
-    // Mary had a Little Lamb: http://www.choose-piano-lessons.com/piano-notes.html
-    const int marySong[] =
-    {
-    //  Ma-----ry    had      a     lit----le    lamb
-        E4,    D4,    C4,    D4,    E4,    E4,    E4,
-    //  lit----le    lamb,   lit----le    lamb
-        D4,    D4,    D4,    E4,    E4,    E4,
-    //  Ma-----ry    had      a     lit----le    lamb
-        E4,    D4,    C4,    D4,    E4,    E4,    E4,
-    //  Its  fleece  was    white   as    snow.
-        E4,    D4,    D4,    E4,    D4,    C4
-    };
-
-    const int maryLength = sizeof(marySong)/sizeof(marySong[0]);
+    sampler->reserve((MARY_LENGTH * 4 + 3) * noteDuration);
 
     // pure, sinusoidal tone; no envelope
-    for(int i=0; i<maryLength; i++)
+    for(int i=0; i<MARY_LENGTH; i++)
     {
-        sampler.sample(&pureTone, marySong[i], noteDuration, &noEnvelope, volume);
+        sampler->sample(&pureTone, MARY_SONG[i], noteDuration, &noEnvelope, volume);
     }
 
     // square waves; no envelope
-    for(int i=0; i<maryLength; i++)
+    for(int i=0; i<MARY_LENGTH; i++)
     {
-        sampler.sample(&squareWave, marySong[i], noteDuration, &noEnvelope, volume);
+        sampler->sample(&squareWave, MARY_SONG[i], noteDuration, &noEnvelope, volume);
     }
 
     // square waves; ADSR envelope
-    for(int i=0; i<maryLength; i++)
+    for(int i=0; i<MARY_LENGTH; i++)
     {
-        sampler.sample(&squareWave, marySong[i], noteDuration, &adsrEnvelope, volume);
+        sampler->sample(&squareWave, MARY_SONG[i], noteDuration, &adsrEnvelope, volume);
     }
 
     // violin; ADSR envelope
-    for(int i=0; i<maryLength; i++)
+    for(int i=0; i<MARY_LENGTH; i++)
     {
-        sampler.sample(&violin, marySong[i], noteDuration, &adsrEnvelope, volume);
+        sampler->sample(&violin, MARY_SONG[i], noteDuration, &adsrEnvelope, volume);
     }
 
-    sampler.sample(&chirp, C4, noteDuration, &adsrEnvelope, volume);
-    sampler.sample(&chirp, C4, noteDuration, &adsrEnvelope, volume);
-    sampler.sample(&chirp, C4, noteDuration, &adsrEnvelope, volume);
-
-    std::ofstream maryFile("output/mary.wav", std::ios::out | std::ios::binary);
-    WAVWriter::writeSamplesToBinaryStream(&sampler, &maryFile);
-    maryFile.close();
-    std::cout << "Wrote output/mary.wav" << std::endl;
-
-    // Bells 1-6, https://web.eecs.utk.edu/~qi/ece505/project/proj1.pdf
-    BellGenerator bell1 = BellGenerator(220, 10,   2);
-    BellGenerator bell2 = BellGenerator(440,  5,   2);
-    BellGenerator bell3 = BellGenerator(220, 10,  12);
-    BellGenerator bell4 = BellGenerator(220, 10, 0.3);
-    BellGenerator bell5 = BellGenerator(350,  5,   2);
-    BellGenerator bell6 = BellGenerator(350,  3,   1);
-
-    BellEnvelope bell1Envelope = BellEnvelope(2);
-    BellEnvelope bell2Envelope = BellEnvelope(2);
-    BellEnvelope bell3Envelope = BellEnvelope(12);
-    BellEnvelope bell4Envelope = BellEnvelope(0.3);
-    BellEnvelope bell5Envelope = BellEnvelope(2);
-    BellEnvelope bell6Envelope = BellEnvelope(1);
-
-    const double bell1Duration = 6;
-    const double bell2Duration = 6;
-    const double bell3Duration = 3;
-    const double bell4Duration = 3;
-    const double bell5Duration = 5;
-    const double bell6Duration = 5;
-
-    Sampler bellSampler = Sampler(sampleRateHz, bitsPerSample, numChannels);
-
-    bellSampler.sample(&bell1, 110, bell1Duration, &bell1Envelope, volume);
-    bellSampler.sample(&bell2, 220, bell2Duration, &bell2Envelope, volume);
-    bellSampler.sample(&bell3, 110, bell3Duration, &bell3Envelope, volume);
-    bellSampler.sample(&bell4, 110, bell4Duration, &bell4Envelope, volume);
-    bellSampler.sample(&bell5, 250, bell5Duration, &bell5Envelope, volume);
-    bellSampler.sample(&bell6, 250, bell6Duration, &bell6Envelope, volume);
-
-    std::ofstream bellFile("output/bells.wav", std::ios::out | std::ios::binary);
-    WAVWriter::writeSamplesToBinaryStream(&bellSampler, &bellFile);
-    bellFile.close();
-    std::cout << "Wrote output/bells.wav" << std::endl;
-
-    return 0;
+    sampler->sample(&chirp, C4, noteDuration, &adsrEnvelope, volume);
+    sampler->sample(&chirp, C4, noteDuration, &adsrEnvelope, volume);
+    sampler->sample(&chirp, C4, noteDuration, &adsrEnvelope, volume);
+}
+
+void Songs::sampleBells(Sampler* sampler, SampleTimeline* timeline, double volume)
+{
+    for(int i=0; i<NUM_BELLS; i++)
+    {
+        const BellPreset& preset = BELLS[i];
+        BellGenerator bell = BellGenerator(preset.fm_Hz, preset.I0, preset.tau);
+        BellEnvelope bellEnvelope = BellEnvelope(preset.tau);
+
+        sampler->sample(&bell, preset.fc_Hz, preset.durationSeconds, &bellEnvelope, volume);
+
+        if(timeline != NULL)
+        {
+            timeline->overwrite(timeline->getLength(), sampler->getSampleData().data(), sampler->getSampleData().size());
+            sampler->clear();
+        }
+    }
 }
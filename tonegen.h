@@ -1,31 +1,56 @@
 #ifndef TONEGEN_H
 #define TONEGEN_H
 
+// Bumped on incompatible changes of the public API (major) and on additions (minor)
+#define TONEGEN_VERSION_MAJOR 1
+#define TONEGEN_VERSION_MINOR 0
+
 #include <climits>
+#include <cstdint>
 
 class ToneGenerator
 {
     public:
+        virtual ~ToneGenerator() {}
+
         // the tone generator returns a continous result between [-1.0, 1.0]
         virtual double generate(int toneFrequencyHz, double timeIndexSeconds, double durationSeconds) = 0;
+
+        // renders numSamples consecutive samples starting at sample index startIndex; the default
+        // implementation calls generate() per sample, subclasses may override it with a faster path
+        virtual void generateBlock(int toneFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples);
+
+        // renders numSamples samples at the fractional sample positions of a pitch modulated note: sample k
+        // is at startPosition + k * ratio + k * (k - 1) / 2 * ratioStep, i.e. the pitch ratio changes by
+        // ratioStep per sample; the default implementation calls generate() per sample
+        virtual void generateWarpedBlock(int toneFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples);
+
+        // scales the modulation index of FM generators, ignored by all others
+        virtual void setIndexScale(double indexScale);
 };
 
 class PureToneGenerator: public ToneGenerator
 {
     public:
         double generate(int toneFrequencyHz, double timeIndexSeconds, double durationSeconds);
+        void generateBlock(int toneFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples);
+        void generateWarpedBlock(int toneFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples);
 };
 
 class SquareWaveGenerator: public ToneGenerator
 {
     public:
         double generate(int toneFrequencyHz, double timeIndexSeconds, double durationSeconds);
+        void generateBlock(int toneFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples);
+        void generateWarpedBlock(int toneFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples);
 };
 
 class ViolinGenerator: public ToneGenerator
 {
     public:
         double generate(int toneFrequencyHz, double timeIndexSeconds, double durationSeconds);
+        void generateBlock(int toneFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples);
+        void generateWarpedBlock(int toneFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples);
 };
 
 class ChirpGenerator: public ToneGenerator
@@ -42,14 +67,77 @@ class BellGenerator: public ToneGenerator
         double tau;
         double theta_m;
         double theta_c;
+        double indexScale;
     public:
         BellGenerator(int fm_Hz, int I0, double tau);
         double generate(int fc_Hz, double timeIndexSeconds, double durationSeconds);
+        void setIndexScale(double indexScale);
+};
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// A PCM WAV file (8 or 16 bits, any number of channels) mapped read-only into memory. Only the header is
+// read up front, the operating system pages sample data in when a note first touches it, so opening
+// even a very large bank is fast. The bank is immutable and can be shared between threads and voices.
+class SampleBank
+{
+    private:
+        void* mapping;
+        size_t mappingSize;
+        const unsigned char* frames;
+        size_t numFrames;
+        int sampleRateHz;
+        int bitsPerSample;
+        int numChannels;
+        SampleBank();
+        SampleBank(const SampleBank&);
+        SampleBank& operator=(const SampleBank&);
+    public:
+        SampleBank(const std::string& path); // throws std::runtime_error if the file is not a usable WAV file
+        ~SampleBank();
+        double getFrame(size_t index);       // channels mixed down, within [-1.0, 1.0]
+        void prefetch(size_t firstFrame, size_t numFrames); // asks the kernel to read ahead, e.g. the attack
+        size_t getNumFrames();
+        int getSampleRateHz();
+};
+
+enum InterpolationMode
+{
+    CUBIC_INTERPOLATION, // 4 point Catmull-Rom spline
+    SINC_INTERPOLATION   // Blackman windowed sinc, SINC_TAPS taps
+};
+
+// Plays a recorded sample from a bank, pitch shifted from its root frequency to the requested one, with
+// an optional sustain loop. The bank is shared, but each voice or thread needs its own generator.
+class SampleGenerator: public ToneGenerator
+{
+    private:
+        std::shared_ptr<SampleBank> bank;
+        int rootFrequencyHz;
+        InterpolationMode interpolation;
+        long loopStartFrame;
+        long loopEndFrame;            // looping is disabled unless loopEndFrame > loopStartFrame
+        std::vector<double> decoded;  // frames decoded for one block by generateBlock()
+        bool isLooping();
+        double frameAt(long index);
+        double interpolate(double position);
+        bool interpolateBlock(double startPosition, double step, double stepChange, double* result, int numSamples);
+    public:
+        static const int SINC_TAPS   = 16;
+        static const int SINC_PHASES = 1024; // fractional positions the sinc kernel is tabulated for
+        SampleGenerator(std::shared_ptr<SampleBank> bank, int rootFrequencyHz, InterpolationMode interpolation);
+        void setLoop(long loopStartFrame, long loopEndFrame);
+        double generate(int toneFrequencyHz, double timeIndexSeconds, double durationSeconds);
+        void generateBlock(int toneFrequencyHz, long startIndex, int sampleRateHz, double durationSeconds, double* result, int numSamples);
+        void generateWarpedBlock(int toneFrequencyHz, double startPosition, double ratio, double ratioStep, int sampleRateHz, double durationSeconds, double* result, int numSamples);
 };
 
 class Envelope
 {
     public:
+        virtual ~Envelope() {}
         virtual double getAmplitude(double timeIndexSeconds) = 0;
 };
 
@@ -84,7 +172,78 @@ class BellEnvelope: public Envelope
         double getAmplitude(double timeIndexSeconds);
 };
 
-#include <vector>
+// A control signal for parameter automation, evaluated at control rate only
+class ControlSource
+{
+    public:
+        virtual ~ControlSource() {}
+        virtual double getValue(double timeIndexSeconds) = 0;
+};
+
+enum LFOShape
+{
+    LFO_SINE,
+    LFO_TRIANGLE,
+    LFO_SQUARE,
+    LFO_SAWTOOTH
+};
+
+// Low frequency oscillator, swings by depth around center, e.g. LFO(5.5, 30, LFO_SINE, 0) as vibrato in
+// cents or LFO(4, 0.2, LFO_SINE, 0.8) as tremolo gain (gains above 1 clip at full volume)
+class LFO: public ControlSource
+{
+    private:
+        double rateHz;
+        double depth;
+        LFOShape shape;
+        double center;
+    public:
+        LFO(double rateHz, double depth, LFOShape shape, double center);
+        double getValue(double timeIndexSeconds);
+};
+
+// Breakpoint automation: linear between breakpoints, holds the first and last value outside of them
+class AutomationCurve: public ControlSource
+{
+    private:
+        std::vector<double> breakpointTimes;
+        std::vector<double> breakpointValues;
+    public:
+        void addBreakpoint(double timeIndexSeconds, double value); // breakpoints must be added in time order
+        double getValue(double timeIndexSeconds);
+};
+
+// Modulation of a note: pitch sources are summed in cents, amplitude and FM index sources are multiplied.
+// Sources are evaluated every controlPeriodSamples samples and interpolated linearly in between.
+// Pitch modulation warps the time index passed to the generator, so time dependent generators (chirp,
+// bell decay) follow the warped time.
+class Modulation
+{
+    private:
+        std::vector<ControlSource*> pitchSources;
+        std::vector<ControlSource*> amplitudeSources;
+        std::vector<ControlSource*> indexSources;
+        double glideSeconds;
+        int controlPeriodSamples;
+        Modulation();
+    public:
+        Modulation(int controlPeriodSamples);
+        void addPitchModulation(ControlSource* cents);
+        void addAmplitudeModulation(ControlSource* gain);
+        void addIndexModulation(ControlSource* indexScale);
+        void setGlide(double glideSeconds); // portamento from the previous note's frequency
+        int getControlPeriodSamples();
+        bool hasIndexModulation();
+        double getPitchCents(double timeIndexSeconds, int previousToneFrequencyHz, int toneFrequencyHz);
+        double getAmplitude(double timeIndexSeconds);
+        double getIndexScale(double timeIndexSeconds);
+};
+
+enum RenderMode
+{
+    REFERENCE_RENDERING, // one generate() call per sample, the output all other modes are verified against
+    BLOCK_RENDERING      // generateBlock() over fixed size blocks, allows incremental generators
+};
 
 class Sampler
 {
@@ -92,17 +251,79 @@ class Sampler
         int sampleRateHz;
         int bitsPerSample;
         int numChannels;
+        RenderMode renderMode;
+        int previousToneFrequencyHz; // start of a glide, 0 before the first note
         std::vector<char> sampleData;
         Sampler();
+        char quantize(double sample);
     public:
+        static const int BLOCK_SIZE = 256; // samples per generateBlock() call in BLOCK_RENDERING mode
         Sampler(int sampleRateHz, int bitsPerSample, int numChannels);
+        void setRenderMode(RenderMode renderMode);
         void sample(ToneGenerator* generator, int toneFrequencyHz, double durationSeconds, Envelope* envelope, double volume);
+        void sample(ToneGenerator* generator, int toneFrequencyHz, double durationSeconds, Envelope* envelope, double volume, Modulation* modulation);
+        void reserve(double durationSeconds); // preallocate room for durationSeconds of samples
+        void clear();                         // drop all samples but keep the allocated buffer for reuse
         int getSampleRateHz();
         int getBitsPerSample();
         int getNumChannels();
         std::vector<char>& getSampleData(); // TODO should consider returning "const" value
 };
 
+// A span of consecutive samples inside a SampleTimeline, valid until the timeline is modified
+typedef struct
+{
+    const char* data;
+    size_t length;
+} SampleSpan;
+
+// Sample storage for long programs: the timeline is cut into fixed-size blocks taken from a pool with a
+// free list. Blocks that contain nothing but silence are not stored at all, so memory grows with the
+// non-silent content rather than with the length of the program.
+class SampleTimeline
+{
+    private:
+        int sampleRateHz;
+        int bitsPerSample;
+        int numChannels;
+        size_t length;                    // in samples, including silence
+        std::vector<char*> blocks;        // NULL for silent blocks
+        std::vector<char*> freeBlocks;
+        std::vector<char*> slabs;         // pool memory, BLOCKS_PER_SLAB blocks each
+        SampleTimeline();
+        SampleTimeline(const SampleTimeline&);
+        SampleTimeline& operator=(const SampleTimeline&);
+        char* allocateBlock();
+        void releaseBlockIfSilent(size_t blockIndex);
+        template<typename Operation> void apply(size_t offset, const char* samples, size_t numSamples, Operation operation);
+    public:
+        static const size_t BLOCK_SIZE      = 4096; // samples per block
+        static const size_t BLOCKS_PER_SLAB = 64;
+        static const char SILENCE           = (char)0x80; // center of the unsigned 8 bit sample range
+
+        class Iterator
+        {
+            private:
+                SampleTimeline* timeline;
+                size_t blockIndex;
+            public:
+                Iterator(SampleTimeline* timeline);
+                bool next(SampleSpan* span); // false at the end of the timeline
+        };
+
+        SampleTimeline(int sampleRateHz, int bitsPerSample, int numChannels);
+        ~SampleTimeline();
+        void overwrite(size_t offset, const char* samples, size_t numSamples); // replaces samples, extends the timeline
+        void mixIn(size_t offset, const char* samples, size_t numSamples);     // adds samples, clipping at the range limits
+        void extend(size_t length);                                            // appends silence up to length samples
+        Iterator iterate();
+        size_t getLength();
+        size_t getStoredBlocks(); // blocks holding non-silent samples
+        int getSampleRateHz();
+        int getBitsPerSample();
+        int getNumChannels();
+};
+
 // Note names, MIDI numbers and frequencies: https://pages.mtu.edu/~suits/notefreqs.html
 // Scientific pitch notation: https://en.wikipedia.org/wiki/Scientific_pitch_notation
 enum NoteFrequencies
@@ -242,10 +463,42 @@ typedef struct // Sound data
     uint32_t Subchunk2Size;
 } DataSubChunk;
 
+#include <ostream>
+
 class WAVWriter
 {
     public:
-        static void writeSamplesToBinaryStream(Sampler* sampler, std::ofstream* wavStream);
+        static const int HEADER_SIZE = 44; // bytes preceding the sample data
+        static void writeSamplesToBinaryStream(Sampler* sampler, std::ostream* wavStream);
+        static void writeTimelineToBinaryStream(SampleTimeline* timeline, std::ostream* wavStream);
+    private:
+        static void writeHeader(int sampleRateHz, int bitsPerSample, int numChannels, size_t numSamples, std::ostream* wavStream);
+};
+
+// Bells 1-6, https://web.eecs.utk.edu/~qi/ece505/project/proj1.pdf
+typedef struct
+{
+    int fm_Hz;
+    int I0;
+    double tau;
+    int fc_Hz;
+    double durationSeconds;
+} BellPreset;
+
+class Songs
+{
+    public:
+        static const int MARY_LENGTH = 26;
+        static const int MARY_SONG[MARY_LENGTH];
+        static const double MARY_NOTE_DURATION; // seconds per note in output/mary.wav
+        static const int NUM_BELLS = 6;
+        static const BellPreset BELLS[NUM_BELLS];
+
+        // the program of output/mary.wav: the song with pure tones, square waves and violin, then chirps
+        static void sampleMary(Sampler* sampler, double noteDuration, double volume);
+
+        // the program of output/bells.wav; with a timeline, each bell is moved there as soon as it is rendered
+        static void sampleBells(Sampler* sampler, SampleTimeline* timeline, double volume);
 };
 
 #endif
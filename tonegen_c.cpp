@@ -0,0 +1,251 @@
+/*
+    Tone generator - C interface
+
+    BSD 2-Clause License
+
+    Copyright (c) 2019, Daniel Lorch
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <ostream>
+#include <streambuf>
+#include <memory>
+#include <fstream>
+#include <cstring>
+#include <climits>
+#include <stdexcept>
+#include "tonegen.h"
+#include "tonegen_c.h"
+
+// The handles are the C++ objects themselves; exceptions never cross the C interface but end up in
+// the calling thread's last error.
+
+static thread_local std::string lastError;
+
+static int fail(const std::string& message)
+{
+    lastError = message;
+    return -1;
+}
+
+template<typename Operation>
+static int guard(Operation operation)
+{
+    try
+    {
+        operation();
+        return 0;
+    }
+    catch(const std::exception& e)
+    {
+        return fail(e.what());
+    }
+    catch(...)
+    {
+        return fail("Unknown error");
+    }
+}
+
+template<typename Handle, typename Constructor>
+static Handle* create(Constructor constructor)
+{
+    Handle* result = NULL;
+    guard([&] { result = (Handle*)constructor(); });
+    return result;
+}
+
+// lets WAVWriter write into a caller provided buffer, failing instead of growing past its end
+class BufferStreamBuffer: public std::streambuf
+{
+    public:
+        BufferStreamBuffer(char* buffer, size_t capacity)
+        {
+            this->setp(buffer, buffer + capacity);
+        }
+};
+
+static Sampler* toSampler(tonegen_sampler* sampler)
+{
+    return (Sampler*)sampler;
+}
+
+int tonegen_version(void)
+{
+    return TONEGEN_VERSION_MAJOR * 100 + TONEGEN_VERSION_MINOR;
+}
+
+const char* tonegen_last_error(void)
+{
+    return lastError.c_str();
+}
+
+tonegen_sampler* tonegen_sampler_new(int sampleRateHz)
+{
+    return create<tonegen_sampler>([&] { return new Sampler(sampleRateHz, CHAR_BIT, 1); });
+}
+
+void tonegen_sampler_free(tonegen_sampler* sampler)
+{
+    delete toSampler(sampler);
+}
+
+int tonegen_sampler_set_render_mode(tonegen_sampler* sampler, int renderMode)
+{
+    if(renderMode != TONEGEN_REFERENCE_RENDERING && renderMode != TONEGEN_BLOCK_RENDERING)
+        return fail("Invalid render mode");
+
+    toSampler(sampler)->setRenderMode(renderMode == TONEGEN_BLOCK_RENDERING ? BLOCK_RENDERING : REFERENCE_RENDERING);
+    return 0;
+}
+
+int tonegen_sampler_sample(tonegen_sampler* sampler, tonegen_generator* generator, int toneFrequencyHz, double durationSeconds, tonegen_envelope* envelope, double volume)
+{
+    return guard([&] { toSampler(sampler)->sample((ToneGenerator*)generator, toneFrequencyHz, durationSeconds, (Envelope*)envelope, volume); });
+}
+
+int tonegen_sampler_sample_song(tonegen_sampler* sampler, const char* name, double volume)
+{
+    return guard([&]
+    {
+        if(strcmp(name, "mary") == 0)
+            Songs::sampleMary(toSampler(sampler), Songs::MARY_NOTE_DURATION, volume);
+        else if(strcmp(name, "bells") == 0)
+            Songs::sampleBells(toSampler(sampler), NULL, volume);
+        else
+            throw std::invalid_argument(std::string("Unknown song: ") + name);
+    });
+}
+
+void tonegen_sampler_clear(tonegen_sampler* sampler)
+{
+    toSampler(sampler)->clear();
+}
+
+const char* tonegen_sampler_data(tonegen_sampler* sampler, size_t* length)
+{
+    std::vector<char>& data = toSampler(sampler)->getSampleData();
+
+    *length = data.size();
+    return data.empty() ? NULL : &data[0];
+}
+
+size_t tonegen_sampler_wav_size(tonegen_sampler* sampler)
+{
+    return WAVWriter::HEADER_SIZE + toSampler(sampler)->getSampleData().size();
+}
+
+int tonegen_sampler_write_wav(tonegen_sampler* sampler, char* buffer, size_t capacity)
+{
+    if(capacity < tonegen_sampler_wav_size(sampler))
+        return fail("Buffer too small for the WAV data");
+
+    return guard([&]
+    {
+        BufferStreamBuffer wavBuffer(buffer, capacity);
+        std::ostream wavStream(&wavBuffer);
+        WAVWriter::writeSamplesToBinaryStream(toSampler(sampler), &wavStream);
+
+        if(!wavStream)
+            throw std::runtime_error("Cannot write WAV data");
+    });
+}
+
+int tonegen_sampler_write_wav_file(tonegen_sampler* sampler, const char* path)
+{
+    return guard([&]
+    {
+        std::ofstream wavFile(path, std::ios::out | std::ios::binary);
+        WAVWriter::writeSamplesToBinaryStream(toSampler(sampler), &wavFile);
+        wavFile.close();
+
+        if(!wavFile)
+            throw std::runtime_error(std::string("Cannot write ") + path);
+    });
+}
+
+tonegen_generator* tonegen_generator_new_pure_tone(void)
+{
+    return create<tonegen_generator>([] { return (ToneGenerator*)new PureToneGenerator(); });
+}
+
+tonegen_generator* tonegen_generator_new_square_wave(void)
+{
+    return create<tonegen_generator>([] { return (ToneGenerator*)new SquareWaveGenerator(); });
+}
+
+tonegen_generator* tonegen_generator_new_violin(void)
+{
+    return create<tonegen_generator>([] { return (ToneGenerator*)new ViolinGenerator(); });
+}
+
+tonegen_generator* tonegen_generator_new_chirp(void)
+{
+    return create<tonegen_generator>([] { return (ToneGenerator*)new ChirpGenerator(); });
+}
+
+tonegen_generator* tonegen_generator_new_bell(int fm_Hz, int I0, double tau)
+{
+    return create<tonegen_generator>([&] { return (ToneGenerator*)new BellGenerator(fm_Hz, I0, tau); });
+}
+
+tonegen_generator* tonegen_generator_new_sample(const char* bankPath, int rootFrequencyHz, int interpolation)
+{
+    if(interpolation != TONEGEN_CUBIC_INTERPOLATION && interpolation != TONEGEN_SINC_INTERPOLATION)
+    {
+        fail("Invalid interpolation");
+        return NULL;
+    }
+
+    return create<tonegen_generator>([&]
+    {
+        std::shared_ptr<SampleBank> bank(new SampleBank(bankPath));
+        return (ToneGenerator*)new SampleGenerator(bank, rootFrequencyHz, interpolation == TONEGEN_SINC_INTERPOLATION ? SINC_INTERPOLATION : CUBIC_INTERPOLATION);
+    });
+}
+
+void tonegen_generator_free(tonegen_generator* generator)
+{
+    delete (ToneGenerator*)generator;
+}
+
+tonegen_envelope* tonegen_envelope_new_none(void)
+{
+    return create<tonegen_envelope>([] { return (Envelope*)new NoEnvelope(); });
+}
+
+tonegen_envelope* tonegen_envelope_new_adsr(double durationSeconds)
+{
+    return create<tonegen_envelope>([&] { return (Envelope*)new ADSREnvelope(durationSeconds); });
+}
+
+tonegen_envelope* tonegen_envelope_new_bell(double tau)
+{
+    return create<tonegen_envelope>([&] { return (Envelope*)new BellEnvelope(tau); });
+}
+
+void tonegen_envelope_free(tonegen_envelope* envelope)
+{
+    delete (Envelope*)envelope;
+}
@@ -0,0 +1,64 @@
+#ifndef TONEGEN_C_H
+#define TONEGEN_C_H
+
+/*
+    C interface of libtonegen, for embedding the tone generator into programs that cannot use the C++
+    classes directly. All objects are opaque handles; functions returning int return 0 on success and
+    -1 on failure, functions returning a handle return NULL on failure, in which case
+    tonegen_last_error() describes the failure of the calling thread.
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tonegen_sampler tonegen_sampler;
+typedef struct tonegen_generator tonegen_generator;
+typedef struct tonegen_envelope tonegen_envelope;
+
+enum
+{
+    TONEGEN_REFERENCE_RENDERING = 0,
+    TONEGEN_BLOCK_RENDERING     = 1
+};
+
+enum
+{
+    TONEGEN_CUBIC_INTERPOLATION = 0,
+    TONEGEN_SINC_INTERPOLATION  = 1
+};
+
+int tonegen_version(void); /* TONEGEN_VERSION_MAJOR * 100 + TONEGEN_VERSION_MINOR */
+const char* tonegen_last_error(void);
+
+tonegen_sampler* tonegen_sampler_new(int sampleRateHz); /* 8 bits, mono */
+void tonegen_sampler_free(tonegen_sampler* sampler);
+int tonegen_sampler_set_render_mode(tonegen_sampler* sampler, int renderMode);
+int tonegen_sampler_sample(tonegen_sampler* sampler, tonegen_generator* generator, int toneFrequencyHz, double durationSeconds, tonegen_envelope* envelope, double volume);
+int tonegen_sampler_sample_song(tonegen_sampler* sampler, const char* name, double volume); /* "mary" or "bells" */
+void tonegen_sampler_clear(tonegen_sampler* sampler);
+const char* tonegen_sampler_data(tonegen_sampler* sampler, size_t* length);
+size_t tonegen_sampler_wav_size(tonegen_sampler* sampler);
+int tonegen_sampler_write_wav(tonegen_sampler* sampler, char* buffer, size_t capacity); /* at least tonegen_sampler_wav_size() */
+int tonegen_sampler_write_wav_file(tonegen_sampler* sampler, const char* path);
+
+tonegen_generator* tonegen_generator_new_pure_tone(void);
+tonegen_generator* tonegen_generator_new_square_wave(void);
+tonegen_generator* tonegen_generator_new_violin(void);
+tonegen_generator* tonegen_generator_new_chirp(void);
+tonegen_generator* tonegen_generator_new_bell(int fm_Hz, int I0, double tau);
+tonegen_generator* tonegen_generator_new_sample(const char* bankPath, int rootFrequencyHz, int interpolation);
+void tonegen_generator_free(tonegen_generator* generator);
+
+tonegen_envelope* tonegen_envelope_new_none(void);
+tonegen_envelope* tonegen_envelope_new_adsr(double durationSeconds);
+tonegen_envelope* tonegen_envelope_new_bell(double tau);
+void tonegen_envelope_free(tonegen_envelope* envelope);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,196 @@
+/*
+    Tone generator - render daemon client
+
+    BSD 2-Clause License
+
+    Copyright (c) 2019, Daniel Lorch
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "tonegend.h"
+
+static int connectToDaemon(const std::string& socketPath)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+        std::cerr << "Cannot connect to " << socketPath << ": " << strerror(errno) << std::endl;
+        exit(1);
+    }
+
+    return fd;
+}
+
+static void sendAll(int fd, const std::string& data)
+{
+    size_t offset = 0;
+
+    while(offset < data.size())
+    {
+        ssize_t sent = send(fd, data.c_str() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if(sent < 0 && errno == EINTR)
+            continue;
+        if(sent <= 0)
+        {
+            std::cerr << "Connection lost: " << strerror(errno) << std::endl;
+            exit(1);
+        }
+        offset += sent;
+    }
+}
+
+// sends one request and returns the reply line, reply holds the open connection for reading any payload
+static std::string request(const std::string& socketPath, const std::string& data, FILE** reply)
+{
+    int fd = connectToDaemon(socketPath);
+    sendAll(fd, data);
+
+    *reply = fdopen(fd, "r");
+
+    char line[1024];
+    if(fgets(line, sizeof(line), *reply) == NULL)
+    {
+        std::cerr << "No reply from daemon" << std::endl;
+        exit(1);
+    }
+
+    std::string result(line);
+    if(!result.empty() && result[result.size() - 1] == '\n')
+        result.erase(result.size() - 1);
+
+    return result;
+}
+
+static void usage()
+{
+    std::cerr << "Usage: tonegenc [-s socketPath] [-p priority] [-o daemonOutputPath | -w localWavPath] [-r retries] scoreFile" << std::endl;
+    std::cerr << "       tonegenc [-s socketPath] -S" << std::endl;
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string socketPath = TONEGEND_DEFAULT_SOCKET_PATH;
+    std::string outputPath = "-";
+    std::string localPath;
+    int priority           = 0;
+    int retries            = 10;
+    bool queryStats        = false;
+
+    int option;
+    while((option = getopt(argc, argv, "s:p:o:w:r:S")) != -1)
+    {
+        switch(option)
+        {
+            case 's': socketPath = optarg;       break;
+            case 'p': priority   = atoi(optarg); break;
+            case 'o': outputPath = optarg;       break;
+            case 'w': localPath  = optarg;       break;
+            case 'r': retries    = atoi(optarg); break;
+            case 'S': queryStats = true;         break;
+            default:  usage();
+        }
+    }
+
+    FILE* reply;
+
+    if(queryStats)
+    {
+        std::cout << request(socketPath, "STATS\n", &reply) << std::endl;
+        fclose(reply);
+        return 0;
+    }
+
+    if(optind != argc - 1 || (outputPath == "-") == localPath.empty())
+        usage();
+
+    std::ifstream scoreFile(argv[optind]);
+    if(!scoreFile)
+    {
+        std::cerr << "Cannot read " << argv[optind] << std::endl;
+        return 1;
+    }
+
+    // read into a string first, inserting the rdbuf() of an empty file would fail the whole stream
+    std::string score((std::istreambuf_iterator<char>(scoreFile)), std::istreambuf_iterator<char>());
+    std::ostringstream job;
+    job << "JOB " << priority << " " << outputPath << "\n" << score << "\nEND\n";
+
+    // back off exponentially while the daemon reports a full queue
+    int backoffMillis = 10;
+    std::string status;
+    for(int attempt=0; ; attempt++)
+    {
+        status = request(socketPath, job.str(), &reply);
+        if(status.compare(0, 5, "BUSY ") != 0 || attempt >= retries)
+            break;
+
+        fclose(reply);
+        usleep(backoffMillis * 1000);
+        backoffMillis = std::min(backoffMillis * 2, 1000);
+    }
+
+    std::cerr << status << std::endl;
+
+    if(status.compare(0, 5, "DONE ") != 0)
+        return 1;
+
+    if(!localPath.empty())
+    {
+        size_t wavBytes = strtoul(status.c_str() + 5, NULL, 10);
+        std::vector<char> wavData(wavBytes);
+
+        if(wavBytes == 0 || fread(&wavData[0], 1, wavBytes, reply) != wavBytes)
+        {
+            std::cerr << "Truncated WAV data" << std::endl;
+            return 1;
+        }
+
+        std::ofstream wavFile(localPath.c_str(), std::ios::out | std::ios::binary);
+        wavFile.write(&wavData[0], wavData.size());
+        std::cout << "Wrote " << localPath << std::endl;
+    }
+
+    fclose(reply);
+
+    return 0;
+}
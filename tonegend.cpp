@@ -0,0 +1,528 @@
+/*
+    Tone generator - render daemon
+
+    BSD 2-Clause License
+
+    Copyright (c) 2019, Daniel Lorch
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "tonegend.h"
+
+static const int BITS_PER_SAMPLE     = CHAR_BIT; // 8 bits, the only depth supported by Sampler
+static const int NUM_CHANNELS        = 1;        // Mono
+static const int MAX_FREQUENCY       = 1000000;  // Hz, for tone and modulator frequencies
+static const int MAX_INDEX           = 1000;     // FM modulation index
+static const size_t MAX_CACHED       = 64;       // generators/envelopes per kind kept by a worker
+
+const double ScoreParser::MAX_DURATION     = 3600;
+const double ScoreParser::MAX_JOB_DURATION = 3600;
+
+static double parseNumber(const std::string& token)
+{
+    char* end;
+    double value = strtod(token.c_str(), &end);
+
+    if(token.empty() || *end != '\0' || !std::isfinite(value))
+        throw std::invalid_argument("not a number: " + token);
+
+    return value;
+}
+
+// parses an integer within [minimum, maximum], checked before the conversion to int
+static int parseInteger(const std::string& token, int minimum, int maximum)
+{
+    double value = parseNumber(token);
+
+    if(value < minimum || value > maximum)
+        throw std::invalid_argument("out of range: " + token);
+
+    return (int)value;
+}
+
+static std::vector<std::string> split(const std::string& text, char separator)
+{
+    std::vector<std::string> tokens;
+    std::istringstream stream(text);
+    std::string token;
+
+    while(std::getline(stream, token, separator))
+        tokens.push_back(token);
+
+    return tokens;
+}
+
+NoteSpec ScoreParser::parseNote(const std::string& line)
+{
+    std::istringstream stream(line);
+    std::string generator, frequency, duration, envelope, volume, trailing;
+
+    if(!(stream >> generator >> frequency >> duration >> envelope >> volume) || (stream >> trailing))
+        throw std::invalid_argument("expected <generator> <frequencyHz> <durationSeconds> <envelope> <volume>");
+
+    NoteSpec note = NoteSpec();
+
+    std::vector<std::string> generatorArgs = split(generator, ':');
+    if(generator == "pure")
+        note.generator = PURE_TONE;
+    else if(generator == "square")
+        note.generator = SQUARE_WAVE;
+    else if(generator == "violin")
+        note.generator = VIOLIN;
+    else if(generator == "chirp")
+        note.generator = CHIRP;
+    else if(generatorArgs.size() == 4 && generatorArgs[0] == "bell")
+    {
+        note.generator = BELL;
+        note.fm_Hz = parseInteger(generatorArgs[1], 0, MAX_FREQUENCY);
+        note.I0    = parseInteger(generatorArgs[2], 0, MAX_INDEX);
+        note.tau   = parseNumber(generatorArgs[3]);
+        if(note.tau <= 0)
+            throw std::invalid_argument("bell tau must be positive");
+    }
+    else
+        throw std::invalid_argument("unknown generator: " + generator);
+
+    note.toneFrequencyHz = parseInteger(frequency, 1, MAX_FREQUENCY);
+
+    note.durationSeconds = parseNumber(duration);
+    if(note.durationSeconds <= 0 || note.durationSeconds > MAX_DURATION)
+        throw std::invalid_argument("duration out of range");
+
+    std::vector<std::string> envelopeArgs = split(envelope, ':');
+    if(envelope == "none")
+        note.envelope = NO_ENVELOPE;
+    else if(envelope == "adsr")
+        note.envelope = ADSR_ENVELOPE;
+    else if(envelopeArgs.size() == 2 && envelopeArgs[0] == "bell")
+    {
+        note.envelope = BELL_ENVELOPE;
+        note.envelopeTau = parseNumber(envelopeArgs[1]);
+        if(note.envelopeTau <= 0)
+            throw std::invalid_argument("bell envelope tau must be positive");
+    }
+    else
+        throw std::invalid_argument("unknown envelope: " + envelope);
+
+    note.volume = parseNumber(volume);
+    if(note.volume != 11 && (note.volume < 0 || note.volume > 1))
+        throw std::invalid_argument("volume must be within range 0.0 .. 1.0");
+
+    return note;
+}
+
+void ScoreParser::parseHeader(const std::string& line, RenderJob* job)
+{
+    std::istringstream header(line);
+    std::string command, priority, outputPath, trailing;
+
+    if(!(header >> command >> priority >> outputPath) || command != "JOB" || (header >> trailing))
+        throw std::invalid_argument("expected JOB <priority> <output> or STATS");
+
+    job->priority   = parseInteger(priority, INT_MIN, INT_MAX);
+    job->outputPath = outputPath;
+}
+
+void ScoreParser::parseLine(const std::string& line, RenderJob* job)
+{
+    if(line.empty() || line[0] == '#')
+        return;
+    if(job->notes.size() >= MAX_NOTES)
+        throw std::invalid_argument("too many notes");
+
+    job->notes.push_back(parseNote(line));
+
+    job->durationSeconds += job->notes.back().durationSeconds;
+    if(job->durationSeconds > MAX_JOB_DURATION)
+        throw std::invalid_argument("job too long");
+}
+
+bool JobQueue::Compare::operator()(const RenderJob* a, const RenderJob* b) const
+{
+    if(a->priority != b->priority)
+        return a->priority < b->priority;
+
+    return a->sequence > b->sequence;
+}
+
+JobQueue::JobQueue(size_t capacity): capacity(capacity), nextSequence(0), closed(false)
+{
+}
+
+bool JobQueue::tryPush(RenderJob* job)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if(this->closed || this->jobs.size() >= this->capacity)
+            return false;
+
+        job->sequence = this->nextSequence++;
+        job->enqueuedAt = std::chrono::steady_clock::now();
+        this->jobs.push(job);
+    }
+
+    this->available.notify_one();
+    return true;
+}
+
+RenderJob* JobQueue::pop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->available.wait(lock, [this] { return this->closed || !this->jobs.empty(); });
+
+    if(this->jobs.empty())
+        return nullptr;
+
+    RenderJob* job = this->jobs.top();
+    this->jobs.pop();
+    return job;
+}
+
+void JobQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+    }
+
+    this->available.notify_all();
+}
+
+size_t JobQueue::size()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->jobs.size();
+}
+
+ConnectionQueue::ConnectionQueue(size_t capacity): capacity(capacity), closed(false)
+{
+}
+
+bool ConnectionQueue::tryPush(int fd)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if(this->closed || this->connections.size() >= this->capacity)
+            return false;
+
+        this->connections.push(fd);
+    }
+
+    this->available.notify_one();
+    return true;
+}
+
+int ConnectionQueue::pop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    this->available.wait(lock, [this] { return this->closed || !this->connections.empty(); });
+
+    if(this->connections.empty())
+        return -1;
+
+    int fd = this->connections.front();
+    this->connections.pop();
+    return fd;
+}
+
+void ConnectionQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+    }
+
+    this->available.notify_all();
+}
+
+RenderStats::RenderStats(): completedJobs(0), failedJobs(0), rejectedJobs(0), renderedSamples(0),
+    totalQueueSeconds(0), totalRenderSeconds(0), maxQueueSeconds(0), maxRenderSeconds(0),
+    startedAt(std::chrono::steady_clock::now())
+{
+}
+
+void RenderStats::recordCompleted(size_t samples, double queueSeconds, double renderSeconds)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->completedJobs++;
+    this->renderedSamples    += samples;
+    this->totalQueueSeconds  += queueSeconds;
+    this->totalRenderSeconds += renderSeconds;
+    this->maxQueueSeconds     = std::max(this->maxQueueSeconds, queueSeconds);
+    this->maxRenderSeconds    = std::max(this->maxRenderSeconds, renderSeconds);
+}
+
+void RenderStats::recordFailed()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->failedJobs++;
+}
+
+void RenderStats::recordRejected()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->rejectedJobs++;
+}
+
+std::string RenderStats::format(size_t queuedJobs)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    double uptimeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->startedAt).count();
+    double jobs = this->completedJobs > 0 ? this->completedJobs : 1;
+
+    std::ostringstream result;
+    result << "STATS"
+           << " completed=" << this->completedJobs
+           << " failed=" << this->failedJobs
+           << " rejected=" << this->rejectedJobs
+           << " queued=" << queuedJobs
+           << " samples=" << this->renderedSamples
+           << " avgQueueMs=" << this->totalQueueSeconds / jobs * 1000
+           << " maxQueueMs=" << this->maxQueueSeconds * 1000
+           << " avgRenderMs=" << this->totalRenderSeconds / jobs * 1000
+           << " maxRenderMs=" << this->maxRenderSeconds * 1000
+           << " samplesPerSecond=" << (this->totalRenderSeconds > 0 ? this->renderedSamples / this->totalRenderSeconds : 0)
+           << " jobsPerSecond=" << (uptimeSeconds > 0 ? this->completedJobs / uptimeSeconds : 0);
+
+    return result.str();
+}
+
+SocketStreamBuffer::SocketStreamBuffer(size_t bufferSize): fd(-1), failed(false), buffer(bufferSize)
+{
+}
+
+void SocketStreamBuffer::attach(int fd)
+{
+    this->fd = fd;
+    this->failed = false;
+    this->setp(&this->buffer[0], &this->buffer[0] + this->buffer.size());
+}
+
+bool SocketStreamBuffer::hasFailed()
+{
+    return this->failed;
+}
+
+bool SocketStreamBuffer::flushBuffer()
+{
+    const char* data = this->pbase();
+    size_t remaining = this->pptr() - this->pbase();
+
+    while(remaining > 0 && !this->failed)
+    {
+        ssize_t sent = send(this->fd, data, remaining, MSG_NOSIGNAL);
+        if(sent < 0 && errno == EINTR)
+            continue;
+        if(sent <= 0)
+            this->failed = true;
+        else
+        {
+            data += sent;
+            remaining -= sent;
+        }
+    }
+
+    this->setp(&this->buffer[0], &this->buffer[0] + this->buffer.size());
+    return !this->failed;
+}
+
+int SocketStreamBuffer::overflow(int c)
+{
+    if(!this->flushBuffer())
+        return traits_type::eof();
+
+    if(c != traits_type::eof())
+    {
+        *this->pptr() = (char)c;
+        this->pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+int SocketStreamBuffer::sync()
+{
+    return this->flushBuffer() ? 0 : -1;
+}
+
+RenderWorker::RenderWorker(int sampleRateHz): sampler(sampleRateHz, BITS_PER_SAMPLE, NUM_CHANNELS), socketBuffer(64 * 1024)
+{
+}
+
+ToneGenerator* RenderWorker::getGenerator(const NoteSpec& note)
+{
+    switch(note.generator)
+    {
+        case PURE_TONE:   return &this->pureTone;
+        case SQUARE_WAVE: return &this->squareWave;
+        case VIOLIN:      return &this->violin;
+        case CHIRP:       return &this->chirp;
+        case BELL:
+        {
+            std::tuple<int, int, double> key(note.fm_Hz, note.I0, note.tau);
+            std::map<std::tuple<int, int, double>, BellGenerator>::iterator it = this->bells.find(key);
+            if(it == this->bells.end())
+            {
+                // parameters come from clients, so the cache must not grow without bound
+                if(this->bells.size() >= MAX_CACHED)
+                    this->bells.clear();
+                it = this->bells.emplace(key, BellGenerator(note.fm_Hz, note.I0, note.tau)).first;
+            }
+            return &it->second;
+        }
+    }
+
+    throw std::logic_error("Unknown generator");
+}
+
+Envelope* RenderWorker::getEnvelope(const NoteSpec& note)
+{
+    switch(note.envelope)
+    {
+        case NO_ENVELOPE:
+            return &this->noEnvelope;
+        case ADSR_ENVELOPE:
+        {
+            // the ADSR envelope is shaped by the note duration
+            std::map<double, ADSREnvelope>::iterator it = this->adsrEnvelopes.find(note.durationSeconds);
+            if(it == this->adsrEnvelopes.end())
+            {
+                if(this->adsrEnvelopes.size() >= MAX_CACHED)
+                    this->adsrEnvelopes.clear();
+                it = this->adsrEnvelopes.emplace(note.durationSeconds, ADSREnvelope(note.durationSeconds)).first;
+            }
+            return &it->second;
+        }
+        case BELL_ENVELOPE:
+        {
+            std::map<double, BellEnvelope>::iterator it = this->bellEnvelopes.find(note.envelopeTau);
+            if(it == this->bellEnvelopes.end())
+            {
+                if(this->bellEnvelopes.size() >= MAX_CACHED)
+                    this->bellEnvelopes.clear();
+                it = this->bellEnvelopes.emplace(note.envelopeTau, BellEnvelope(note.envelopeTau)).first;
+            }
+            return &it->second;
+        }
+    }
+
+    throw std::logic_error("Unknown envelope");
+}
+
+void sendLine(int fd, const std::string& line)
+{
+    std::string data = line + "\n";
+    send(fd, data.c_str(), data.size(), MSG_NOSIGNAL);
+}
+
+void RenderWorker::render(RenderJob* job, RenderStats* stats)
+{
+    std::chrono::steady_clock::time_point startedAt = std::chrono::steady_clock::now();
+    double queueSeconds = std::chrono::duration<double>(startedAt - job->enqueuedAt).count();
+
+    try
+    {
+        // the buffer keeps its capacity from earlier jobs, so only the first long job pays for growing it
+        this->sampler.clear();
+        this->sampler.reserve(job->durationSeconds);
+
+        for(size_t i=0; i < job->notes.size(); i++)
+        {
+            const NoteSpec& note = job->notes[i];
+            this->sampler.sample(this->getGenerator(note), note.toneFrequencyHz, note.durationSeconds, this->getEnvelope(note), note.volume);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        stats->recordFailed();
+        sendLine(job->fd, std::string("ERROR ") + e.what());
+        return;
+    }
+
+    double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startedAt).count();
+    size_t wavBytes = WAVWriter::HEADER_SIZE + this->sampler.getSampleData().size();
+
+    std::ostringstream reply;
+    reply << "DONE " << (job->outputPath == "-" ? wavBytes : 0)
+          << " " << (long long)(queueSeconds * 1e6)
+          << " " << (long long)(renderSeconds * 1e6);
+
+    if(job->outputPath == "-")
+    {
+        this->socketBuffer.attach(job->fd);
+        std::ostream socketStream(&this->socketBuffer);
+        socketStream << reply.str() << "\n";
+        WAVWriter::writeSamplesToBinaryStream(&this->sampler, &socketStream);
+        socketStream.flush();
+
+        if(this->socketBuffer.hasFailed())
+        {
+            stats->recordFailed();
+            return;
+        }
+    }
+    else
+    {
+        std::ofstream wavFile(job->outputPath.c_str(), std::ios::out | std::ios::binary);
+        WAVWriter::writeSamplesToBinaryStream(&this->sampler, &wavFile);
+        wavFile.close();
+
+        if(!wavFile)
+        {
+            stats->recordFailed();
+            sendLine(job->fd, "ERROR cannot write " + job->outputPath);
+            return;
+        }
+
+        sendLine(job->fd, reply.str());
+    }
+
+    stats->recordCompleted(this->sampler.getSampleData().size(), queueSeconds, renderSeconds);
+}
+
+void RenderWorker::run(JobQueue* queue, RenderStats* stats)
+{
+    while(RenderJob* job = queue->pop())
+    {
+        this->render(job, stats);
+        close(job->fd);
+        delete job;
+    }
+}
@@ -0,0 +1,195 @@
+#ifndef TONEGEND_H
+#define TONEGEND_H
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <condition_variable>
+#include <streambuf>
+#include <chrono>
+#include "tonegen.h"
+
+// Wire protocol of the render daemon (one request per connection, text lines terminated by '\n', the
+// whole request has to arrive within 10 seconds):
+//
+//   JOB <priority> <output>        output is a file path on the daemon's side, or "-" to stream the WAV back
+//   <generator> <frequencyHz> <durationSeconds> <envelope> <volume>
+//   ...                            at least one note
+//   END
+//
+//   STATS                          query per-job latency and throughput statistics
+//
+// Generators: pure, square, violin, chirp, bell:<fm_Hz>:<I0>:<tau>
+// Envelopes:  none, adsr, bell:<tau>
+//
+// Replies: "DONE <wavBytes> <queueMicros> <renderMicros>" (followed by wavBytes of WAV data when streaming),
+//          "BUSY <queuedJobs>" when the job queue is full (backpressure, retry later), "ERROR <message>" or
+//          "STATS key=value ...".
+
+#define TONEGEND_DEFAULT_SOCKET_PATH "/tmp/tonegend.sock"
+
+enum GeneratorType
+{
+    PURE_TONE,
+    SQUARE_WAVE,
+    VIOLIN,
+    CHIRP,
+    BELL
+};
+
+enum EnvelopeType
+{
+    NO_ENVELOPE,
+    ADSR_ENVELOPE,
+    BELL_ENVELOPE
+};
+
+struct NoteSpec
+{
+    GeneratorType generator;
+    int fm_Hz;     // BELL only
+    int I0;        // BELL only
+    double tau;    // BELL only
+    int toneFrequencyHz;
+    double durationSeconds;
+    EnvelopeType envelope;
+    double envelopeTau; // BELL_ENVELOPE only
+    double volume;
+};
+
+struct RenderJob
+{
+    int fd;                 // client connection, the reply is written here
+    int priority;           // higher priorities are rendered first
+    unsigned long sequence; // FIFO order among jobs of equal priority
+    std::string outputPath; // "-" streams the WAV back to the client
+    std::vector<NoteSpec> notes;
+    double durationSeconds; // of all notes together
+    std::chrono::steady_clock::time_point enqueuedAt;
+};
+
+class ScoreParser
+{
+    public:
+        static const size_t MAX_NOTES = 100000;
+        static const double MAX_DURATION;     // seconds per note
+        static const double MAX_JOB_DURATION; // seconds per job, bounds the sample buffer of each worker
+
+        // parses a single score line into a note, throws std::invalid_argument on malformed input
+        static NoteSpec parseNote(const std::string& line);
+
+        // parses the "JOB <priority> <output>" line of a request into job
+        static void parseHeader(const std::string& line, RenderJob* job);
+
+        // adds a score line to job, skipping empty lines and comments; throws std::invalid_argument on
+        // malformed input and once the job exceeds MAX_NOTES or MAX_JOB_DURATION
+        static void parseLine(const std::string& line, RenderJob* job);
+};
+
+// Bounded priority queue shared between the accepting thread and the worker pool
+class JobQueue
+{
+    private:
+        struct Compare
+        {
+            bool operator()(const RenderJob* a, const RenderJob* b) const;
+        };
+        std::priority_queue<RenderJob*, std::vector<RenderJob*>, Compare> jobs;
+        size_t capacity;
+        unsigned long nextSequence;
+        bool closed;
+        std::mutex mutex;
+        std::condition_variable available;
+    public:
+        JobQueue(size_t capacity);
+        bool tryPush(RenderJob* job); // false if the queue is full or closed; the caller keeps ownership
+        RenderJob* pop();             // blocks until a job is available, nullptr once closed and drained
+        void close();
+        size_t size();
+};
+
+// Bounded queue of accepted connections waiting for a reader thread, so that slow clients never stall
+// the accept loop
+class ConnectionQueue
+{
+    private:
+        std::queue<int> connections;
+        size_t capacity;
+        bool closed;
+        std::mutex mutex;
+        std::condition_variable available;
+    public:
+        ConnectionQueue(size_t capacity);
+        bool tryPush(int fd); // false if the queue is full or closed; the caller keeps the connection
+        int pop();            // blocks until a connection is available, -1 once closed and drained
+        void close();
+};
+
+class RenderStats
+{
+    private:
+        unsigned long completedJobs;
+        unsigned long failedJobs;
+        unsigned long rejectedJobs;
+        unsigned long long renderedSamples;
+        double totalQueueSeconds;
+        double totalRenderSeconds;
+        double maxQueueSeconds;
+        double maxRenderSeconds;
+        std::chrono::steady_clock::time_point startedAt;
+        std::mutex mutex;
+    public:
+        RenderStats();
+        void recordCompleted(size_t samples, double queueSeconds, double renderSeconds);
+        void recordFailed();
+        void recordRejected();
+        std::string format(size_t queuedJobs);
+};
+
+// Writes straight to a socket through a fixed buffer, so streaming a WAV needs no intermediate copy
+class SocketStreamBuffer: public std::streambuf
+{
+    private:
+        int fd;
+        bool failed;
+        std::vector<char> buffer;
+        bool flushBuffer();
+    protected:
+        int overflow(int c);
+        int sync();
+    public:
+        SocketStreamBuffer(size_t bufferSize);
+        void attach(int fd);
+        bool hasFailed();
+};
+
+// writes a reply line to a client, ignoring clients that have gone away
+void sendLine(int fd, const std::string& line);
+
+// Each worker owns a reusable Sampler, its generators and envelopes, so that their buffers and
+// parameters stay warm across jobs (the caches keyed by client parameters are bounded)
+class RenderWorker
+{
+    private:
+        Sampler sampler;
+        PureToneGenerator pureTone;
+        SquareWaveGenerator squareWave;
+        ViolinGenerator violin;
+        ChirpGenerator chirp;
+        NoEnvelope noEnvelope;
+        std::map<std::tuple<int, int, double>, BellGenerator> bells;
+        std::map<double, ADSREnvelope> adsrEnvelopes;
+        std::map<double, BellEnvelope> bellEnvelopes;
+        SocketStreamBuffer socketBuffer;
+        ToneGenerator* getGenerator(const NoteSpec& note);
+        Envelope* getEnvelope(const NoteSpec& note);
+    public:
+        RenderWorker(int sampleRateHz);
+        void run(JobQueue* queue, RenderStats* stats);
+        void render(RenderJob* job, RenderStats* stats);
+};
+
+#endif
@@ -0,0 +1,313 @@
+/*
+    Tone generator - render daemon, socket server
+
+    BSD 2-Clause License
+
+    Copyright (c) 2019, Daniel Lorch
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <stdexcept>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include "tonegend.h"
+
+static const size_t MAX_LINE_LENGTH = 1024;
+static const int REQUEST_TIMEOUT    = 10; // seconds a client may take to send its whole request
+
+static volatile sig_atomic_t shutdownRequested = 0;
+
+static void requestShutdown(int signal)
+{
+    shutdownRequested = 1;
+}
+
+// reads one '\n'-terminated line, keeping any bytes past it in pending for the next call; gives up
+// once the deadline for the whole request has passed
+static bool readLine(int fd, std::string& pending, std::string& line, std::chrono::steady_clock::time_point deadline)
+{
+    size_t newline;
+
+    while((newline = pending.find('\n')) == std::string::npos)
+    {
+        if(pending.size() > MAX_LINE_LENGTH)
+            return false;
+
+        long long remainingMillis = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if(remainingMillis <= 0)
+            return false;
+
+        struct pollfd pollFd = { fd, POLLIN, 0 };
+        int ready = poll(&pollFd, 1, (int)remainingMillis);
+        if(ready < 0 && errno == EINTR)
+            continue;
+        if(ready <= 0)
+            return false;
+
+        char chunk[4096];
+        ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+        if(received < 0 && errno == EINTR)
+            continue;
+        if(received <= 0)
+            return false;
+
+        pending.append(chunk, received);
+    }
+
+    line = pending.substr(0, newline);
+    pending.erase(0, newline + 1);
+
+    if(!line.empty() && line[line.size() - 1] == '\r')
+        line.erase(line.size() - 1);
+
+    return true;
+}
+
+// reads and validates a request, then either answers it directly or hands it to the worker pool
+static void handleConnection(int fd, JobQueue* queue, RenderStats* stats)
+{
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(REQUEST_TIMEOUT);
+    std::string pending, line;
+
+    if(!readLine(fd, pending, line, deadline))
+    {
+        close(fd);
+        return;
+    }
+
+    if(line == "STATS")
+    {
+        sendLine(fd, stats->format(queue->size()));
+        close(fd);
+        return;
+    }
+
+    RenderJob* job = new RenderJob();
+    job->fd = fd;
+
+    try
+    {
+        ScoreParser::parseHeader(line, job);
+
+        for(;;)
+        {
+            if(!readLine(fd, pending, line, deadline))
+                throw std::invalid_argument("incomplete job, missing END or timed out");
+            if(line == "END")
+                break;
+
+            ScoreParser::parseLine(line, job);
+        }
+
+        if(job->notes.empty())
+            throw std::invalid_argument("job without notes");
+    }
+    catch(const std::exception& e)
+    {
+        stats->recordFailed();
+        sendLine(fd, std::string("ERROR ") + e.what());
+        close(fd);
+        delete job;
+        return;
+    }
+
+    if(!queue->tryPush(job))
+    {
+        stats->recordRejected();
+        sendLine(fd, "BUSY " + std::to_string(queue->size()));
+        close(fd);
+        delete job;
+    }
+}
+
+static void readConnections(ConnectionQueue* connections, JobQueue* queue, RenderStats* stats)
+{
+    int fd;
+
+    while((fd = connections->pop()) >= 0)
+        handleConnection(fd, queue, stats);
+}
+
+// removes a socket left behind by a daemon that is gone, but neither other files nor the socket of a
+// daemon that is still running
+static bool removeStaleSocket(const std::string& socketPath, const struct sockaddr_un& address)
+{
+    struct stat status;
+    if(lstat(socketPath.c_str(), &status) < 0)
+    {
+        if(errno == ENOENT)
+            return true;
+
+        std::cerr << "Cannot access " << socketPath << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if(!S_ISSOCK(status.st_mode))
+    {
+        std::cerr << "Not a socket, refusing to replace it: " << socketPath << std::endl;
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool live = fd >= 0 && connect(fd, (const struct sockaddr*)&address, sizeof(address)) == 0;
+    if(fd >= 0)
+        close(fd);
+
+    if(live)
+    {
+        std::cerr << "Another daemon is already listening on " << socketPath << std::endl;
+        return false;
+    }
+
+    if(unlink(socketPath.c_str()) < 0)
+    {
+        std::cerr << "Cannot remove stale socket " << socketPath << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static void usage()
+{
+    std::cerr << "Usage: tonegend [-s socketPath] [-w workers] [-c readers] [-q queueCapacity] [-r sampleRateHz]" << std::endl;
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string socketPath = TONEGEND_DEFAULT_SOCKET_PATH;
+    int numWorkers         = std::max(1u, std::thread::hardware_concurrency());
+    int numReaders         = 4;
+    int queueCapacity      = 64;
+    int sampleRateHz       = 22050;
+
+    int option;
+    while((option = getopt(argc, argv, "s:w:c:q:r:")) != -1)
+    {
+        switch(option)
+        {
+            case 's': socketPath    = optarg;       break;
+            case 'w': numWorkers    = atoi(optarg); break;
+            case 'c': numReaders    = atoi(optarg); break;
+            case 'q': queueCapacity = atoi(optarg); break;
+            case 'r': sampleRateHz  = atoi(optarg); break;
+            default:  usage();
+        }
+    }
+
+    if(optind != argc || numWorkers <= 0 || numReaders <= 0 || queueCapacity <= 0 || sampleRateHz <= 0)
+        usage();
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if(socketPath.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "Socket path too long: " << socketPath << std::endl;
+        return 1;
+    }
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    if(!removeStaleSocket(socketPath, address))
+        return 1;
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listenFd < 0 || bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listenFd, SOMAXCONN) < 0)
+    {
+        std::cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, requestShutdown);
+    signal(SIGTERM, requestShutdown);
+
+    JobQueue queue(queueCapacity);
+    RenderStats stats;
+
+    std::vector<RenderWorker*> workers;
+    std::vector<std::thread> threads;
+    for(int i=0; i < numWorkers; i++)
+    {
+        workers.push_back(new RenderWorker(sampleRateHz));
+        threads.push_back(std::thread(&RenderWorker::run, workers.back(), &queue, &stats));
+    }
+
+    // requests are read and parsed by the readers, each within REQUEST_TIMEOUT
+    ConnectionQueue connections(queueCapacity);
+    std::vector<std::thread> readers;
+    for(int i=0; i < numReaders; i++)
+        readers.push_back(std::thread(readConnections, &connections, &queue, &stats));
+
+    std::cout << "Listening on " << socketPath << " with " << numWorkers << " workers and " << numReaders << " readers" << std::endl;
+
+    while(!shutdownRequested)
+    {
+        struct pollfd pollFd = { listenFd, POLLIN, 0 };
+        if(poll(&pollFd, 1, 200) <= 0)
+            continue;
+
+        int fd = accept(listenFd, NULL, NULL);
+        if(fd < 0)
+            continue;
+
+        if(!connections.tryPush(fd))
+        {
+            stats.recordRejected();
+            sendLine(fd, "BUSY " + std::to_string(queue.size()));
+            close(fd);
+        }
+    }
+
+    close(listenFd);
+    unlink(socketPath.c_str());
+
+    // requests being read still reach the job queue
+    connections.close();
+    for(size_t i=0; i < readers.size(); i++)
+        readers[i].join();
+
+    // finish the jobs already accepted before exiting
+    queue.close();
+    for(size_t i=0; i < threads.size(); i++)
+    {
+        threads[i].join();
+        delete workers[i];
+    }
+
+    std::cout << stats.format(0) << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,866 @@
+/*
+    Tone generator - verification of accelerated rendering paths
+
+    BSD 2-Clause License
+
+    Copyright (c) 2019, Daniel Lorch
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+    FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+    DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+    CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+    OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <complex>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <unistd.h>
+#include "tonegen.h"
+#include "tonegen_c.h"
+#include "tonegend.h"
+
+// Every accelerated rendering path is compared against the reference path, which calls generate()
+// once per sample. Paths that are meant to be byte-exact are additionally checked against golden
+// hashes of the reference output; regenerate the table with "./verify --print-golden" only after
+// an intentional change of the sound.
+
+static const int SAMPLE_RATE_HZ     = 22050;
+static const int TONE_FREQUENCY_HZ  = A4;
+static const double NOTE_DURATION   = 1.0;   // seconds
+static const double LONG_DURATION   = 120.0; // seconds, for detecting accumulated phase drift
+static const double VOLUME          = 0.75;
+static const int FFT_SIZE           = 16384;
+static const int CONTROL_PERIOD     = 32;    // samples between evaluations of modulation sources
+
+static const double MAX_ABS_ERROR     = 1e-9;
+static const double MIN_SNR_DB        = 120.0;
+static const double MAX_SPECTRAL_DIST = 1e-6; // relative L2 distance of the magnitude spectra
+static const int MAX_LSB_DIFFERENCE   = 1;    // after quantization, for paths that are not byte-exact
+
+struct GoldenHash
+{
+    const char* name;
+    uint64_t hash;
+};
+
+static const GoldenHash goldenHashes[] =
+{
+    { "pure/none", 0x45485925dd54936eULL },
+    { "pure/adsr", 0x524627f33c9dcd17ULL },
+    { "pure/bell", 0xbe6babec23a80dbeULL },
+    { "square/none", 0x8c222b38be7b29aaULL },
+    { "square/adsr", 0x872c134e1ed2376cULL },
+    { "square/bell", 0x8b66ca7d655b31ccULL },
+    { "violin/none", 0x9c297fc346312e37ULL },
+    { "violin/adsr", 0x866976e481eeed0bULL },
+    { "violin/bell", 0x0fcdf78f35201355ULL },
+    { "chirp/none", 0x9b3dba6d40203458ULL },
+    { "chirp/adsr", 0xcd312bfc8485cf9aULL },
+    { "chirp/bell", 0x94fa38c0ee62723fULL },
+    { "bell/none", 0xb1ae9b62735b8764ULL },
+    { "bell/adsr", 0x8b5bfa9639a936b7ULL },
+    { "bell/bell", 0xa53f82071c544102ULL },
+    { "sample-cubic/none", 0xd3e7eba3ec2db6e9ULL },
+    { "sample-cubic/adsr", 0x520cf16961025545ULL },
+    { "sample-cubic/bell", 0xc087da89b476890fULL },
+    { "sample-sinc/none", 0x325e3d734fd93e60ULL },
+    { "sample-sinc/adsr", 0xa3c3881a444853faULL },
+    { "sample-sinc/bell", 0x857e081baa78655bULL }
+};
+
+struct Comparison
+{
+    double maxAbsError;
+    double snrDb;
+    double spectralDistance;
+};
+
+static uint64_t fnv1a(const std::vector<char>& data)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for(size_t i=0; i < data.size(); i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+// iterative radix-2 Cooley-Tukey FFT, data.size() must be a power of two
+static void fft(std::vector<std::complex<double> >& data)
+{
+    const size_t n = data.size();
+
+    for(size_t i=1, j=0; i < n; i++)
+    {
+        size_t bit = n >> 1;
+        for(; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+
+        if(i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    for(size_t length=2; length <= n; length <<= 1)
+    {
+        double angle = -2 * M_PI / length;
+        std::complex<double> step(cos(angle), sin(angle));
+
+        for(size_t start=0; start < n; start += length)
+        {
+            std::complex<double> twiddle(1.0, 0.0);
+
+            for(size_t k=0; k < length / 2; k++)
+            {
+                std::complex<double> even = data[start + k];
+                std::complex<double> odd  = data[start + k + length / 2] * twiddle;
+                data[start + k]              = even + odd;
+                data[start + k + length / 2] = even - odd;
+                twiddle *= step;
+            }
+        }
+    }
+}
+
+// magnitude spectrum of FFT_SIZE samples from offset, Hann windowed
+static std::vector<double> magnitudeSpectrum(const std::vector<double>& signal, size_t offset)
+{
+    std::vector<std::complex<double> > data(FFT_SIZE);
+
+    for(int i=0; i < FFT_SIZE; i++)
+    {
+        double window = 0.5 - 0.5 * cos(2 * M_PI * i / (FFT_SIZE - 1));
+        data[i] = signal[offset + i] * window;
+    }
+
+    fft(data);
+
+    std::vector<double> result(FFT_SIZE / 2 + 1);
+    for(size_t i=0; i < result.size(); i++)
+        result[i] = std::abs(data[i]);
+
+    return result;
+}
+
+static Comparison compare(const std::vector<double>& reference, const std::vector<double>& accelerated, size_t spectrumOffset)
+{
+    Comparison result;
+    double signalEnergy = 0, noiseEnergy = 0;
+
+    result.maxAbsError = 0;
+    for(size_t i=0; i < reference.size(); i++)
+    {
+        double error = reference[i] - accelerated[i];
+        result.maxAbsError = std::max(result.maxAbsError, std::fabs(error));
+        signalEnergy += reference[i] * reference[i];
+        noiseEnergy  += error * error;
+    }
+
+    result.snrDb = noiseEnergy > 0 ? 10 * log10(signalEnergy / noiseEnergy) : INFINITY;
+
+    std::vector<double> referenceSpectrum   = magnitudeSpectrum(reference, spectrumOffset);
+    std::vector<double> acceleratedSpectrum = magnitudeSpectrum(accelerated, spectrumOffset);
+    double distance = 0, magnitude = 0;
+
+    for(size_t i=0; i < referenceSpectrum.size(); i++)
+    {
+        double difference = referenceSpectrum[i] - acceleratedSpectrum[i];
+        distance  += difference * difference;
+        magnitude += referenceSpectrum[i] * referenceSpectrum[i];
+    }
+
+    result.spectralDistance = magnitude > 0 ? sqrt(distance / magnitude) : sqrt(distance);
+
+    return result;
+}
+
+static long numSamples(double durationSeconds)
+{
+    return (long)ceil(SAMPLE_RATE_HZ * durationSeconds);
+}
+
+static std::vector<double> renderReference(ToneGenerator* generator, Envelope* envelope, double durationSeconds)
+{
+    std::vector<double> result(numSamples(durationSeconds));
+
+    for(size_t i=0; i < result.size(); i++)
+    {
+        double timeIndexSeconds = (double)i / SAMPLE_RATE_HZ;
+        result[i] = generator->generate(TONE_FREQUENCY_HZ, timeIndexSeconds, durationSeconds) * envelope->getAmplitude(timeIndexSeconds) * VOLUME;
+    }
+
+    return result;
+}
+
+static std::vector<double> renderBlocks(ToneGenerator* generator, Envelope* envelope, double durationSeconds)
+{
+    std::vector<double> result(numSamples(durationSeconds));
+
+    for(long start=0; start < (long)result.size(); start += Sampler::BLOCK_SIZE)
+    {
+        int blockSamples = (int)std::min((long)Sampler::BLOCK_SIZE, (long)result.size() - start);
+        generator->generateBlock(TONE_FREQUENCY_HZ, start, SAMPLE_RATE_HZ, durationSeconds, &result[start], blockSamples);
+    }
+
+    for(size_t i=0; i < result.size(); i++)
+        result[i] = result[i] * envelope->getAmplitude((double)i / SAMPLE_RATE_HZ) * VOLUME;
+
+    return result;
+}
+
+// renders a vibrato one control period at a time, through the generator's generateWarpedBlock() or
+// through the default implementation, which calls generate() per sample
+static std::vector<double> renderWarped(ToneGenerator* generator, bool perSample)
+{
+    std::vector<double> result(numSamples(NOTE_DURATION));
+    LFO vibrato(5.5, 30, LFO_SINE, 0);
+    double position = 0;
+
+    for(long start=0; start < (long)result.size(); start += CONTROL_PERIOD)
+    {
+        int periodSamples = (int)std::min((long)CONTROL_PERIOD, (long)result.size() - start);
+        double ratio = pow(2, vibrato.getValue((double)start / SAMPLE_RATE_HZ) / 1200);
+        double nextRatio = pow(2, vibrato.getValue((double)(start + CONTROL_PERIOD) / SAMPLE_RATE_HZ) / 1200);
+        double ratioStep = (nextRatio - ratio) / CONTROL_PERIOD;
+
+        if(perSample)
+            generator->ToneGenerator::generateWarpedBlock(TONE_FREQUENCY_HZ, position, ratio, ratioStep, SAMPLE_RATE_HZ, NOTE_DURATION, &result[start], periodSamples);
+        else
+            generator->generateWarpedBlock(TONE_FREQUENCY_HZ, position, ratio, ratioStep, SAMPLE_RATE_HZ, NOTE_DURATION, &result[start], periodSamples);
+
+        position += periodSamples * ratio + 0.5 * periodSamples * (periodSamples - 1) * ratioStep;
+    }
+
+    return result;
+}
+
+static std::vector<char> renderSampler(ToneGenerator* generator, Envelope* envelope, double durationSeconds, RenderMode renderMode)
+{
+    Sampler sampler(SAMPLE_RATE_HZ, CHAR_BIT, 1);
+    sampler.setRenderMode(renderMode);
+    sampler.sample(generator, TONE_FREQUENCY_HZ, durationSeconds, envelope, VOLUME);
+
+    return sampler.getSampleData();
+}
+
+// renders a note with modulation, after a note at previousToneFrequencyHz to glide from (if not 0)
+static std::vector<char> renderModulated(ToneGenerator* generator, Envelope* envelope, double durationSeconds, Modulation* modulation, int previousToneFrequencyHz, RenderMode renderMode)
+{
+    Sampler sampler(SAMPLE_RATE_HZ, CHAR_BIT, 1);
+    sampler.setRenderMode(renderMode);
+
+    if(previousToneFrequencyHz > 0)
+        sampler.sample(generator, previousToneFrequencyHz, NOTE_DURATION, envelope, VOLUME);
+
+    size_t offset = sampler.getSampleData().size();
+    sampler.sample(generator, TONE_FREQUENCY_HZ, durationSeconds, envelope, VOLUME, modulation);
+
+    return std::vector<char>(sampler.getSampleData().begin() + offset, sampler.getSampleData().end());
+}
+
+static int maxLsbDifference(const std::vector<char>& a, const std::vector<char>& b)
+{
+    if(a.size() != b.size())
+        return INT_MAX;
+
+    int result = 0;
+    for(size_t i=0; i < a.size(); i++)
+        result = std::max(result, std::abs((int)(unsigned char)a[i] - (int)(unsigned char)b[i]));
+
+    return result;
+}
+
+static const GoldenHash* findGoldenHash(const std::string& name)
+{
+    for(size_t i=0; i < sizeof(goldenHashes)/sizeof(goldenHashes[0]); i++)
+    {
+        if(name == goldenHashes[i].name)
+            return &goldenHashes[i];
+    }
+
+    return NULL;
+}
+
+static bool report(const std::string& name, const std::string& check, bool passed, const std::string& details)
+{
+    std::cout << (passed ? "PASS " : "FAIL ") << std::left << std::setw(22) << name << std::setw(10) << check << details << std::endl;
+    return passed;
+}
+
+static std::string formatComparison(const Comparison& comparison)
+{
+    std::ostringstream result;
+    result << std::scientific << std::setprecision(2)
+           << "maxAbs=" << comparison.maxAbsError
+           << " snr=" << std::fixed << std::setprecision(1) << comparison.snrDb << "dB"
+           << " spectral=" << std::scientific << std::setprecision(2) << comparison.spectralDistance;
+    return result.str();
+}
+
+static bool comparisonPassed(const Comparison& comparison)
+{
+    return comparison.maxAbsError <= MAX_ABS_ERROR && comparison.snrDb >= MIN_SNR_DB && comparison.spectralDistance <= MAX_SPECTRAL_DIST;
+}
+
+// a sine wave exactly on an FFT bin must peak in that bin, and the energy must match (Parseval)
+static bool verifyFFT()
+{
+    const int bin = 1000;
+    std::vector<std::complex<double> > data(FFT_SIZE);
+    double timeEnergy = 0, frequencyEnergy = 0;
+
+    for(int i=0; i < FFT_SIZE; i++)
+    {
+        data[i] = sin(2 * M_PI * bin * i / FFT_SIZE);
+        timeEnergy += std::norm(data[i]);
+    }
+
+    fft(data);
+
+    int peak = 0;
+    for(int i=0; i < FFT_SIZE; i++)
+    {
+        frequencyEnergy += std::norm(data[i]);
+        if(i <= FFT_SIZE / 2 && std::abs(data[i]) > std::abs(data[peak]))
+            peak = i;
+    }
+
+    double parsevalError = std::fabs(frequencyEnergy / FFT_SIZE - timeEnergy) / timeEnergy;
+
+    std::ostringstream details;
+    details << "peak=" << peak << " parsevalError=" << std::scientific << std::setprecision(2) << parsevalError;
+
+    return report("fft", "selftest", peak == bin && parsevalError < 1e-12, details.str());
+}
+
+// records a violin note into a temporary WAV file to serve as sample bank, returns its path
+static std::string writeSampleBank(double durationSeconds)
+{
+    ViolinGenerator violin;
+    NoEnvelope noEnvelope;
+    Sampler sampler(SAMPLE_RATE_HZ, CHAR_BIT, 1);
+    sampler.sample(&violin, G4, durationSeconds, &noEnvelope, VOLUME);
+
+    char path[] = "/tmp/tonegen-verify-XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0)
+        throw std::runtime_error("Cannot create temporary sample bank");
+    close(fd);
+
+    std::ofstream bankFile(path, std::ios::out | std::ios::binary);
+    WAVWriter::writeSamplesToBinaryStream(&sampler, &bankFile);
+
+    return path;
+}
+
+// the timeline must hold exactly what a flat buffer holds after the same edits, storing only sound
+static bool verifyTimeline(ToneGenerator* generator, Envelope* envelope)
+{
+    std::vector<char> note = renderSampler(generator, envelope, NOTE_DURATION, REFERENCE_RENDERING);
+    const size_t length = 60 * SAMPLE_RATE_HZ;
+    const size_t offsets[] = { 5 * SAMPLE_RATE_HZ + 17, 5 * SAMPLE_RATE_HZ + 5000, 40 * SAMPLE_RATE_HZ };
+
+    std::vector<char> flat(length, SampleTimeline::SILENCE);
+    SampleTimeline timeline(SAMPLE_RATE_HZ, CHAR_BIT, 1);
+    timeline.extend(length);
+
+    std::copy(note.begin(), note.end(), flat.begin() + offsets[0]);
+    timeline.overwrite(offsets[0], &note[0], note.size());
+
+    for(size_t n=1; n < sizeof(offsets)/sizeof(offsets[0]); n++)
+    {
+        for(size_t i=0; i < note.size(); i++)
+        {
+            int mixed = (unsigned char)flat[offsets[n] + i] + (unsigned char)note[i] - 128;
+            flat[offsets[n] + i] = (char)std::max(0, std::min(255, mixed));
+        }
+        timeline.mixIn(offsets[n], &note[0], note.size());
+    }
+
+    // overwriting with silence releases blocks again
+    std::vector<char> silence(note.size(), SampleTimeline::SILENCE);
+    std::copy(silence.begin(), silence.end(), flat.begin() + offsets[2]);
+    timeline.overwrite(offsets[2], &silence[0], silence.size());
+
+    std::vector<char> iterated;
+    SampleTimeline::Iterator iterator = timeline.iterate();
+    SampleSpan span;
+    while(iterator.next(&span))
+        iterated.insert(iterated.end(), span.data, span.data + span.length);
+
+    size_t maxBlocks = (offsets[1] + note.size() - offsets[0]) / SampleTimeline::BLOCK_SIZE + 2;
+
+    std::ostringstream details;
+    details << "maxLsbDiff=" << maxLsbDifference(flat, iterated) << " storedBlocks=" << timeline.getStoredBlocks()
+            << "/" << (length + SampleTimeline::BLOCK_SIZE - 1) / SampleTimeline::BLOCK_SIZE;
+
+    return report("timeline", "sparse", iterated == flat && timeline.getStoredBlocks() <= maxBlocks, details.str());
+}
+
+static void appendLittleEndian(std::string* data, uint32_t value, int bytes)
+{
+    for(int i=0; i < bytes; i++)
+        data->push_back((char)(value >> (8 * i)));
+}
+
+// the same violin note as writeSampleBank(), as 16 bit stereo whose channels mix down to the 8 bit bank,
+// with an odd-sized unknown chunk (padded to an even size) between the format and the data chunk
+static std::string writeWideSampleBank(double durationSeconds)
+{
+    ViolinGenerator violin;
+    std::string data;
+
+    for(int i=0; i < SAMPLE_RATE_HZ * durationSeconds; i++)
+    {
+        double sample = VOLUME * violin.generate(G4, (double)i / SAMPLE_RATE_HZ, durationSeconds);
+        appendLittleEndian(&data, (uint16_t)(int16_t)lrint(1.2 * sample * 32767), 2);
+        appendLittleEndian(&data, (uint16_t)(int16_t)lrint(0.8 * sample * 32767), 2);
+    }
+
+    std::string unknown = "tonegen";
+    std::string wav = "RIFF";
+    appendLittleEndian(&wav, 4 + (8 + 16) + (8 + unknown.size() + 1) + (8 + data.size()), 4);
+    wav += "WAVEfmt ";
+    appendLittleEndian(&wav, 16, 4);
+    appendLittleEndian(&wav, 1, 2);                      // PCM
+    appendLittleEndian(&wav, 2, 2);                      // channels
+    appendLittleEndian(&wav, SAMPLE_RATE_HZ, 4);
+    appendLittleEndian(&wav, SAMPLE_RATE_HZ * 2 * 2, 4); // byte rate
+    appendLittleEndian(&wav, 2 * 2, 2);                  // block align
+    appendLittleEndian(&wav, 16, 2);                     // bits per sample
+    wav += "junk";
+    appendLittleEndian(&wav, unknown.size(), 4);
+    wav += unknown + '\0';
+    wav += "data";
+    appendLittleEndian(&wav, data.size(), 4);
+    wav += data;
+
+    char path[] = "/tmp/tonegen-verify-XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0)
+        throw std::runtime_error("Cannot create temporary sample bank");
+    close(fd);
+
+    std::ofstream bankFile(path, std::ios::out | std::ios::binary);
+    bankFile.write(wav.data(), wav.size());
+
+    return path;
+}
+
+// a 16 bit stereo bank with an unknown chunk must decode to the 8 bit mono bank, within its quantization
+static bool verifyWideSampleBank(SampleBank* bank)
+{
+    std::string widePath = writeWideSampleBank(NOTE_DURATION);
+    SampleBank wideBank(widePath);
+    unlink(widePath.c_str());
+
+    double maxAbsError = 0;
+    for(size_t i=0; i < std::min(bank->getNumFrames(), wideBank.getNumFrames()); i++)
+        maxAbsError = std::max(maxAbsError, fabs(bank->getFrame(i) - wideBank.getFrame(i)));
+
+    std::ostringstream details;
+    details << "frames=" << wideBank.getNumFrames() << " maxAbs=" << std::scientific << std::setprecision(2) << maxAbsError;
+
+    bool passed = wideBank.getNumFrames() == bank->getNumFrames() && wideBank.getSampleRateHz() == bank->getSampleRateHz()
+               && maxAbsError <= 1.0 / 128 + 1.0 / 32768;
+
+    return report("sample-bank", "16bit", passed, details.str());
+}
+
+// gains above 1 must clip at full scale instead of wrapping around between 0 and 255
+static bool verifyClipping()
+{
+    PureToneGenerator pureTone;
+    NoEnvelope noEnvelope;
+    LFO tremolo(4, 0.2, LFO_SINE, 1);
+    Modulation modulation(CONTROL_PERIOD);
+    modulation.addAmplitudeModulation(&tremolo);
+
+    Sampler sampler(SAMPLE_RATE_HZ, CHAR_BIT, 1);
+    sampler.sample(&pureTone, TONE_FREQUENCY_HZ, 0.2, &noEnvelope, 1.0, &modulation);
+
+    // a sine at A4 moves by about 20 steps between samples at this gain, a wrap moves by almost 256
+    const std::vector<char>& data = sampler.getSampleData();
+    int maxStep = 0;
+    for(size_t i=1; i < data.size(); i++)
+        maxStep = std::max(maxStep, abs((unsigned char)data[i] - (unsigned char)data[i - 1]));
+
+    std::ostringstream details;
+    details << "maxStep=" << maxStep;
+
+    return report("tremolo", "clipping", maxStep < 64, details.str());
+}
+
+// the C interface must render exactly what the C++ classes render
+static bool verifyCInterface()
+{
+    Sampler sampler(SAMPLE_RATE_HZ, CHAR_BIT, 1);
+    Songs::sampleMary(&sampler, Songs::MARY_NOTE_DURATION, VOLUME);
+
+    tonegen_sampler* cSampler = tonegen_sampler_new(SAMPLE_RATE_HZ);
+    bool passed = tonegen_sampler_sample_song(cSampler, "mary", VOLUME) == 0;
+
+    size_t length;
+    const char* data = tonegen_sampler_data(cSampler, &length);
+    passed = passed && std::vector<char>(data, data + length) == sampler.getSampleData();
+
+    std::vector<char> wav(tonegen_sampler_wav_size(cSampler));
+    passed = passed && tonegen_sampler_write_wav(cSampler, &wav[0], wav.size()) == 0;
+    passed = passed && std::vector<char>(wav.begin() + WAVWriter::HEADER_SIZE, wav.end()) == sampler.getSampleData();
+    passed = passed && tonegen_sampler_write_wav(cSampler, &wav[0], wav.size() - 1) == -1;
+
+    // a sampler without samples writes just the header
+    tonegen_sampler* emptySampler = tonegen_sampler_new(SAMPLE_RATE_HZ);
+    std::vector<char> emptyWav(tonegen_sampler_wav_size(emptySampler));
+    passed = passed && emptyWav.size() == WAVWriter::HEADER_SIZE && tonegen_sampler_write_wav(emptySampler, &emptyWav[0], emptyWav.size()) == 0;
+    tonegen_sampler_free(emptySampler);
+
+    // errors are reported, not thrown
+    tonegen_generator* pureTone = tonegen_generator_new_pure_tone();
+    tonegen_envelope* noEnvelope = tonegen_envelope_new_none();
+    passed = passed && tonegen_sampler_sample(cSampler, pureTone, A4, 0.1, noEnvelope, 2.0) == -1 && strlen(tonegen_last_error()) > 0;
+    passed = passed && tonegen_generator_new_sample("/nonexistent.wav", A4, TONEGEN_SINC_INTERPOLATION) == NULL;
+    passed = passed && tonegen_generator_new_sample("/nonexistent.wav", A4, 2) == NULL && strcmp(tonegen_last_error(), "Invalid interpolation") == 0;
+
+    tonegen_envelope_free(noEnvelope);
+    tonegen_generator_free(pureTone);
+    tonegen_sampler_free(cSampler);
+
+    std::ostringstream details;
+    details << "version=" << tonegen_version() << " samples=" << length;
+
+    return report("c-interface", "mary", passed, details.str());
+}
+
+// returns whether parsing the score line into a fresh job or into job is rejected
+static bool rejectsLine(const std::string& line, RenderJob* job = NULL)
+{
+    RenderJob freshJob = RenderJob();
+
+    try
+    {
+        ScoreParser::parseLine(line, job != NULL ? job : &freshJob);
+    }
+    catch(const std::invalid_argument&)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+// the daemon's validation of requests, before any of them reaches a worker
+static bool verifyScoreParser()
+{
+    bool passed = !rejectsLine("bell:220:10:2 440 1.5 bell:2 0.5") && !rejectsLine("# comment") && !rejectsLine("");
+
+    // values that are out of range or not numbers at all
+    const char* malformed[] =
+    {
+        "pure 1e12 1 none 1",
+        "pure -440 1 none 1",
+        "pure nan 1 none 1",
+        "pure 440 nan none 1",
+        "pure 440 inf none 1",
+        "pure 440 1 none nan",
+        "bell:1e12:10:2 440 1 none 1",
+        "bell:220:-5:2 440 1 none 1",
+        "bell:220:10:nan 440 1 none 1",
+        "pure 440 1 bell:-1 1",
+        "organ 440 1 none 1",
+        "pure 440 1 none 1 trailing"
+    };
+    int rejected = 0;
+    for(size_t i=0; i < sizeof(malformed)/sizeof(malformed[0]); i++)
+        rejected += rejectsLine(malformed[i]);
+    passed = passed && rejected == (int)(sizeof(malformed)/sizeof(malformed[0]));
+
+    RenderJob header = RenderJob();
+    ScoreParser::parseHeader("JOB -3 -", &header);
+    passed = passed && header.priority == -3 && header.outputPath == "-";
+    try
+    {
+        ScoreParser::parseHeader("JOB 1e12 -", &header);
+        passed = false;
+    }
+    catch(const std::invalid_argument&)
+    {
+    }
+
+    // notes that are fine each, but not all together
+    RenderJob longJob = RenderJob();
+    bool longRejected = false;
+    for(int i=0; i <= ScoreParser::MAX_JOB_DURATION / 600 && !longRejected; i++)
+        longRejected = rejectsLine("pure 440 600 none 1", &longJob);
+    passed = passed && longRejected && longJob.durationSeconds > ScoreParser::MAX_JOB_DURATION;
+
+    RenderJob crowdedJob = RenderJob();
+    bool crowdedRejected = false;
+    for(size_t i=0; i <= ScoreParser::MAX_NOTES && !crowdedRejected; i++)
+        crowdedRejected = rejectsLine("pure 440 0.001 none 1", &crowdedJob);
+    passed = passed && crowdedRejected && crowdedJob.notes.size() == ScoreParser::MAX_NOTES;
+
+    std::ostringstream details;
+    details << "malformed=" << rejected << " notes=" << crowdedJob.notes.size();
+
+    return report("tonegend", "parser", passed, details.str());
+}
+
+// the daemon's job queue: priorities first, FIFO among equal priorities, BUSY once full
+static bool verifyJobQueue()
+{
+    const int priorities[] = { 0, 5, 0, 5, -1 };
+    const int numJobs = sizeof(priorities)/sizeof(priorities[0]);
+    JobQueue queue(numJobs);
+    RenderJob jobs[numJobs];
+
+    bool passed = true;
+    for(int i=0; i < numJobs; i++)
+    {
+        jobs[i].fd = i;
+        jobs[i].priority = priorities[i];
+        passed = passed && queue.tryPush(&jobs[i]);
+    }
+
+    RenderJob extraJob = RenderJob();
+    passed = passed && !queue.tryPush(&extraJob) && queue.size() == (size_t)numJobs;
+
+    // priority 5 in the order pushed, then priority 0 in the order pushed, then -1
+    const int expected[] = { 1, 3, 0, 2, 4 };
+    std::ostringstream details;
+    details << "order=";
+    for(int i=0; i < numJobs; i++)
+    {
+        RenderJob* job = queue.pop();
+        details << job->fd;
+        passed = passed && job->fd == expected[i];
+    }
+
+    queue.close();
+    passed = passed && queue.pop() == NULL && !queue.tryPush(&extraJob);
+
+    return report("tonegend", "queue", passed, details.str());
+}
+
+int main(int argc, char* argv[])
+{
+    bool printGolden = argc == 2 && strcmp(argv[1], "--print-golden") == 0;
+
+    PureToneGenerator pureTone;
+    SquareWaveGenerator squareWave;
+    ViolinGenerator violin;
+    ChirpGenerator chirp;
+    BellGenerator bell(220, 10, 2);
+
+    // the bank is recorded at G4, so playing A4 shifts the pitch; the sinc voice loops the middle half
+    std::string bankPath = writeSampleBank(NOTE_DURATION);
+    std::shared_ptr<SampleBank> bank(new SampleBank(bankPath));
+    unlink(bankPath.c_str()); // the mapping stays valid
+    SampleGenerator cubicSample(bank, G4, CUBIC_INTERPOLATION);
+    SampleGenerator sincSample(bank, G4, SINC_INTERPOLATION);
+    sincSample.setLoop(SAMPLE_RATE_HZ / 4, SAMPLE_RATE_HZ * 3 / 4);
+
+    NoEnvelope noEnvelope;
+    ADSREnvelope adsrEnvelope(NOTE_DURATION);
+    BellEnvelope bellEnvelope(2);
+
+    // byteExact: no accelerated path, generateBlock() falls back to generate()
+    // continuous: output changes smoothly with time, the chirp jumps between integer frequencies, so any
+    // pitch modulation moves the jumps and cannot be compared sample by sample
+    struct { const char* name; ToneGenerator* generator; bool byteExact; bool continuous; } generators[] =
+    {
+        { "pure",         &pureTone,    false, true  },
+        { "square",       &squareWave,  false, true  },
+        { "violin",       &violin,      false, true  },
+        { "chirp",        &chirp,       true,  false },
+        { "bell",         &bell,        true,  true  },
+        { "sample-cubic", &cubicSample, false, true  },
+        { "sample-sinc",  &sincSample,  false, true  }
+    };
+
+    struct { const char* name; Envelope* envelope; } envelopes[] =
+    {
+        { "none", &noEnvelope   },
+        { "adsr", &adsrEnvelope },
+        { "bell", &bellEnvelope }
+    };
+
+    if(printGolden)
+    {
+        for(size_t g=0; g < sizeof(generators)/sizeof(generators[0]); g++)
+        {
+            for(size_t e=0; e < sizeof(envelopes)/sizeof(envelopes[0]); e++)
+            {
+                std::string name = std::string(generators[g].name) + "/" + envelopes[e].name;
+                std::vector<char> reference = renderSampler(generators[g].generator, envelopes[e].envelope, NOTE_DURATION, REFERENCE_RENDERING);
+                std::cout << "    { \"" << name << "\", 0x" << std::hex << std::setw(16) << std::setfill('0') << fnv1a(reference) << "ULL }," << std::dec << std::endl;
+            }
+        }
+
+        return 0;
+    }
+
+    int failures = 0;
+
+    if(!verifyFFT())
+        failures++;
+
+    if(!verifyTimeline(&squareWave, &adsrEnvelope))
+        failures++;
+
+    if(!verifyCInterface())
+        failures++;
+
+    if(!verifyClipping())
+        failures++;
+
+    if(!verifyScoreParser())
+        failures++;
+
+    if(!verifyJobQueue())
+        failures++;
+
+    if(!verifyWideSampleBank(bank.get()))
+        failures++;
+
+    for(size_t g=0; g < sizeof(generators)/sizeof(generators[0]); g++)
+    {
+        for(size_t e=0; e < sizeof(envelopes)/sizeof(envelopes[0]); e++)
+        {
+            ToneGenerator* generator = generators[g].generator;
+            Envelope* envelope = envelopes[e].envelope;
+            std::string name = std::string(generators[g].name) + "/" + envelopes[e].name;
+
+            // continuous output of the accelerated path against the reference path
+            Comparison comparison = compare(renderReference(generator, envelope, NOTE_DURATION), renderBlocks(generator, envelope, NOTE_DURATION), 0);
+            if(!report(name, "block", comparisonPassed(comparison), formatComparison(comparison)))
+                failures++;
+
+            // quantized output of the reference path against the golden hash
+            std::vector<char> reference = renderSampler(generator, envelope, NOTE_DURATION, REFERENCE_RENDERING);
+            const GoldenHash* golden = findGoldenHash(name);
+            std::ostringstream details;
+            details << "fnv1a=0x" << std::hex << fnv1a(reference);
+            if(!report(name, "golden", golden != NULL && golden->hash == fnv1a(reference), details.str()))
+                failures++;
+
+            // quantized output of the accelerated path: byte-exact, or at most MAX_LSB_DIFFERENCE off
+            std::vector<char> accelerated = renderSampler(generator, envelope, NOTE_DURATION, BLOCK_RENDERING);
+            int lsbDifference = maxLsbDifference(reference, accelerated);
+            details.str("");
+            details << std::dec << "maxLsbDiff=" << lsbDifference << (generators[g].byteExact ? " (byte-exact)" : "");
+            if(!report(name, "sampler", generators[g].byteExact ? lsbDifference == 0 : lsbDifference <= MAX_LSB_DIFFERENCE, details.str()))
+                failures++;
+
+            // the modulation path without any sources must match the plain path of the same render mode
+            Modulation noModulation(CONTROL_PERIOD);
+            lsbDifference = maxLsbDifference(reference, renderModulated(generator, envelope, NOTE_DURATION, &noModulation, 0, REFERENCE_RENDERING));
+            int blockLsbDifference = maxLsbDifference(accelerated, renderModulated(generator, envelope, NOTE_DURATION, &noModulation, 0, BLOCK_RENDERING));
+            details.str("");
+            details << std::dec << "maxLsbDiff=" << lsbDifference << " (byte-exact) block=" << blockLsbDifference;
+            if(!report(name, "modulated", lsbDifference == 0 && blockLsbDifference <= MAX_LSB_DIFFERENCE, details.str()))
+                failures++;
+
+            if(!generators[g].continuous)
+                continue;
+
+            // control rate modulation against modulation evaluated at every sample
+            LFO vibrato(5.5, 30, LFO_SINE, 0);
+            LFO tremolo(4, 0.2, LFO_TRIANGLE, 0.8);
+            AutomationCurve indexCurve;
+            indexCurve.addBreakpoint(0, 0.5);
+            indexCurve.addBreakpoint(NOTE_DURATION, 1.5);
+
+            Modulation controlRate(CONTROL_PERIOD), sampleRate(1);
+            Modulation* modulations[] = { &controlRate, &sampleRate };
+            for(int m=0; m < 2; m++)
+            {
+                modulations[m]->addPitchModulation(&vibrato);
+                modulations[m]->addAmplitudeModulation(&tremolo);
+                modulations[m]->addIndexModulation(&indexCurve);
+                modulations[m]->setGlide(0.2);
+            }
+
+            std::vector<char> controlReference = renderModulated(generator, envelope, NOTE_DURATION, &controlRate, C4, REFERENCE_RENDERING);
+            lsbDifference = maxLsbDifference(renderModulated(generator, envelope, NOTE_DURATION, &sampleRate, C4, REFERENCE_RENDERING), controlReference);
+            details.str("");
+            details << std::dec << "maxLsbDiff=" << lsbDifference;
+            if(!report(name, "control", lsbDifference <= MAX_LSB_DIFFERENCE, details.str()))
+                failures++;
+
+            // modulation in BLOCK_RENDERING mode against the reference path, with and without pitch
+            // modulation, so that both the generateBlock() periods and the warped periods are covered
+            Modulation unpitched(CONTROL_PERIOD);
+            unpitched.addAmplitudeModulation(&tremolo);
+            unpitched.addIndexModulation(&indexCurve);
+
+            lsbDifference = maxLsbDifference(controlReference, renderModulated(generator, envelope, NOTE_DURATION, &controlRate, C4, BLOCK_RENDERING));
+            blockLsbDifference = maxLsbDifference(renderModulated(generator, envelope, NOTE_DURATION, &unpitched, 0, REFERENCE_RENDERING), renderModulated(generator, envelope, NOTE_DURATION, &unpitched, 0, BLOCK_RENDERING));
+            details.str("");
+            details << std::dec << "maxLsbDiff=" << lsbDifference << " unpitched=" << blockLsbDifference;
+            if(!report(name, "blockmod", lsbDifference <= MAX_LSB_DIFFERENCE && blockLsbDifference <= MAX_LSB_DIFFERENCE, details.str()))
+                failures++;
+        }
+    }
+
+    // warped blocks of pitch modulated notes against generate() at the same positions
+    for(size_t g=0; g < sizeof(generators)/sizeof(generators[0]); g++)
+    {
+        if(generators[g].byteExact)
+            continue;
+
+        Comparison comparison = compare(renderWarped(generators[g].generator, true), renderWarped(generators[g].generator, false), 0);
+        if(!report(std::string(generators[g].name) + "/vibrato", "warped", comparisonPassed(comparison), formatComparison(comparison)))
+            failures++;
+    }
+
+    // incremental generators must not drift from the reference over long notes
+    for(size_t g=0; g < sizeof(generators)/sizeof(generators[0]); g++)
+    {
+        if(generators[g].byteExact)
+            continue;
+
+        std::vector<double> reference = renderReference(generators[g].generator, &noEnvelope, LONG_DURATION);
+        std::vector<double> accelerated = renderBlocks(generators[g].generator, &noEnvelope, LONG_DURATION);
+        Comparison comparison = compare(reference, accelerated, reference.size() - FFT_SIZE);
+        if(!report(std::string(generators[g].name) + "/long", "block", comparisonPassed(comparison), formatComparison(comparison)))
+            failures++;
+    }
+
+    if(failures == 0)
+        std::cout << "All checks passed" << std::endl;
+    else
+        std::cout << failures << " checks failed" << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}